@@ -1,10 +1,30 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
 #include <time.h>
 #include <omp.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#define max(x, y) ((x) > (y) ? (x) : (y))
+#define min(x, y) ((x) < (y) ? (x) : (y))
 #define HYPERTHREADING 1 // 1 if hyperthreading is on, 0 otherwise
 #define MAX_VAL        5 // Random values are [0, MAX_VAL]
 
+// Bandwidth benchmark parameters (STREAM-like, "stream" mode)
+#define STREAM_NTIMES     5          // Measures per point, the best one is kept
+#define STREAM_MIN_BYTES  (16 << 10) // Smallest working set (fits in L1)
+#define STREAM_LLC_FACTOR 4          // Largest working set = factor * LLC size
+#define STREAM_PASS_BYTES (64 << 20) // Minimum traffic per measure (bytes)
+#define STREAM_SCALAR     3.
+
+// Fused vector operations parameters
+#define VOP_BLOCK       512 // Elements per block (4 KiB per vector, L1 resident)
+#define VOP_MAX_VECTORS 16  // Maximum number of vectors in a pipeline
+#define VOP_MAX_OPS     16  // Maximum number of operations in a pipeline
+
 // Matrix and vector sizes (5120: UHD TV)
 #define N 5120000
 
@@ -16,26 +36,382 @@ void addvec_reference(double c[N], double a[N], double b[N]) {
   }
 }
 
-// Computation kernel (to parallelize)
-void addvec_kernel(double c[N], double a[N], double b[N]) {
-  
-  for (size_t i = 0; i < N; i++) {
+// Runtime-sized vector operations, one parallel pass each
+void vec_add(size_t n, double c[n], double a[n], double b[n]) {
+  #pragma omp parallel for simd schedule(static)
+  for (size_t i = 0; i < n; i++)
     c[i] = a[i] + b[i];
+}
+
+void vec_sub(size_t n, double c[n], double a[n], double b[n]) {
+  #pragma omp parallel for simd schedule(static)
+  for (size_t i = 0; i < n; i++)
+    c[i] = a[i] - b[i];
+}
+
+void vec_mul(size_t n, double c[n], double a[n], double b[n]) {
+  #pragma omp parallel for simd schedule(static)
+  for (size_t i = 0; i < n; i++)
+    c[i] = a[i] * b[i];
+}
+
+void vec_scale(size_t n, double c[n], double a[n], double s) {
+  #pragma omp parallel for simd schedule(static)
+  for (size_t i = 0; i < n; i++)
+    c[i] = a[i] * s;
+}
+
+// c = a * s + b
+void vec_axpy(size_t n, double c[n], double a[n], double s, double b[n]) {
+  #pragma omp parallel for simd schedule(static)
+  for (size_t i = 0; i < n; i++)
+    c[i] = a[i] * s + b[i];
+}
+
+/**
+ * Fused vector operations:
+ * a pipeline records a chain of elementwise operations between vectors
+ * identified by small integers, e.g. for c = a + b; d = c * s + e:
+ *   vop_pipeline p;
+ *   vop_init(&p, n);
+ *   int va = vop_vector(&p, a), vb = vop_vector(&p, b), ve = vop_vector(&p, e);
+ *   int vc = vop_vector(&p, NULL), vd = vop_vector(&p, d);
+ *   vop_add(&p, vc, va, vb);
+ *   vop_axpy(&p, vd, vc, s, ve);
+ *   vop_run(&p);
+ * vop_run makes a single parallel pass: each thread applies the whole chain
+ * to VOP_BLOCK elements at a time, so intermediate results stay in L1.
+ * Vectors registered with NULL are temporaries: they only exist inside the
+ * blocks and are never written to memory. Others are read or written in
+ * place (an operation may write a vector it reads).
+ */
+typedef enum { VOP_ADD, VOP_SUB, VOP_MUL, VOP_SCALE, VOP_AXPY } vop_code;
+
+typedef struct {
+  vop_code code;
+  int dst, src1, src2; // Vector identifiers (src2 unused by VOP_SCALE)
+  double s;            // Scalar of VOP_SCALE and VOP_AXPY
+} vop;
+
+typedef struct {
+  size_t n;
+  int nb_vectors;
+  int nb_ops;
+  double* vectors[VOP_MAX_VECTORS];
+  vop ops[VOP_MAX_OPS];
+} vop_pipeline;
+
+void vop_init(vop_pipeline* p, size_t n) {
+  p->n = n;
+  p->nb_vectors = 0;
+  p->nb_ops = 0;
+}
+
+// Registers a vector of p->n elements (NULL for a temporary), returns its id
+int vop_vector(vop_pipeline* p, double* v) {
+  if (p->nb_vectors == VOP_MAX_VECTORS) {
+    printf("Too many vectors in the pipeline (max %d)\n", VOP_MAX_VECTORS);
+    exit(1);
   }
+  p->vectors[p->nb_vectors] = v;
+  return p->nb_vectors++;
 }
 
-int main() {
+static void vop_push(vop_pipeline* p, vop_code code, int dst, int src1, int src2, double s) {
+  if (p->nb_ops == VOP_MAX_OPS) {
+    printf("Too many operations in the pipeline (max %d)\n", VOP_MAX_OPS);
+    exit(1);
+  }
+  p->ops[p->nb_ops].code = code;
+  p->ops[p->nb_ops].dst = dst;
+  p->ops[p->nb_ops].src1 = src1;
+  p->ops[p->nb_ops].src2 = src2;
+  p->ops[p->nb_ops].s = s;
+  p->nb_ops++;
+}
+
+void vop_add(vop_pipeline* p, int c, int a, int b) { vop_push(p, VOP_ADD, c, a, b, 0.); }
+void vop_sub(vop_pipeline* p, int c, int a, int b) { vop_push(p, VOP_SUB, c, a, b, 0.); }
+void vop_mul(vop_pipeline* p, int c, int a, int b) { vop_push(p, VOP_MUL, c, a, b, 0.); }
+void vop_scale(vop_pipeline* p, int c, int a, double s) { vop_push(p, VOP_SCALE, c, a, a, s); }
+void vop_axpy(vop_pipeline* p, int c, int a, double s, int b) { vop_push(p, VOP_AXPY, c, a, b, s); }
+
+void vop_run(vop_pipeline* p) {
+  size_t nb_blocks = (p->n + VOP_BLOCK - 1) / VOP_BLOCK;
+
+  #pragma omp parallel
+  {
+    double temp[VOP_MAX_VECTORS][VOP_BLOCK];
+    double* blk[VOP_MAX_VECTORS];
+
+    #pragma omp for schedule(static)
+    for (size_t k = 0; k < nb_blocks; k++) {
+      size_t start = k * VOP_BLOCK;
+      size_t len = min(VOP_BLOCK, p->n - start);
+
+      for (int v = 0; v < p->nb_vectors; v++)
+        blk[v] = (p->vectors[v] != NULL) ? p->vectors[v] + start : temp[v];
+
+      for (int o = 0; o < p->nb_ops; o++) {
+        double* c = blk[p->ops[o].dst];
+        double* a = blk[p->ops[o].src1];
+        double* b = blk[p->ops[o].src2];
+        double s = p->ops[o].s;
+
+        switch (p->ops[o].code) {
+          case VOP_ADD:
+            #pragma omp simd
+            for (size_t i = 0; i < len; i++)
+              c[i] = a[i] + b[i];
+            break;
+          case VOP_SUB:
+            #pragma omp simd
+            for (size_t i = 0; i < len; i++)
+              c[i] = a[i] - b[i];
+            break;
+          case VOP_MUL:
+            #pragma omp simd
+            for (size_t i = 0; i < len; i++)
+              c[i] = a[i] * b[i];
+            break;
+          case VOP_SCALE:
+            #pragma omp simd
+            for (size_t i = 0; i < len; i++)
+              c[i] = a[i] * s;
+            break;
+          case VOP_AXPY:
+            #pragma omp simd
+            for (size_t i = 0; i < len; i++)
+              c[i] = a[i] * s + b[i];
+            break;
+        }
+      }
+    }
+  }
+}
+
+// Computation kernel (to parallelize)
+void addvec_kernel(size_t n, double c[n], double a[n], double b[n]) {
+  vec_add(n, c, a, b);
+}
+
+// Bandwidth kernels (STREAM: copy, scale, add, triad)
+/**
+ * thread_range function:
+ * this function gives the calling thread its part [lo, hi) of an array of
+ * n doubles. Bounds are multiples of a cache line (8 doubles) so that the
+ * threads never share a line and aligned vector stores can be used.
+ * \param n  is the number of elements
+ * \param lo is the first element of the thread part
+ * \param hi is the element after the last one of the thread part
+ */
+static void thread_range(size_t n, size_t* lo, size_t* hi) {
+  size_t nb_threads = omp_get_num_threads();
+  size_t tid = omp_get_thread_num();
+  size_t lines = (n + 7) / 8;
+
+  *lo = min(n, lines * tid / nb_threads * 8);
+  *hi = min(n, lines * (tid + 1) / nb_threads * 8);
+}
+
+/**
+ * stream_* functions:
+ * the four STREAM kernels, parallelized over cache-line aligned slices.
+ * When nontemporal is true, results are written with streaming stores which
+ * bypass the caches and avoid the read-for-ownership of the target lines:
+ * only worth it when the arrays do not fit in the last level cache.
+ * Arrays must be 16-byte aligned.
+ */
+void stream_copy(size_t n, double c[n], double a[n], bool nontemporal) {
+  #pragma omp parallel
+  {
+    size_t lo, hi, i = 0;
+    thread_range(n, &lo, &hi);
+    i = lo;
+#ifdef __SSE2__
+    if (nontemporal) {
+      for (; i + 1 < hi; i += 2)
+        _mm_stream_pd(&c[i], _mm_load_pd(&a[i]));
+      _mm_sfence();
+    }
+#endif
+    for (; i < hi; i++)
+      c[i] = a[i];
+  }
+}
+
+void stream_scale(size_t n, double b[n], double c[n], double s, bool nontemporal) {
+  #pragma omp parallel
+  {
+    size_t lo, hi, i = 0;
+    thread_range(n, &lo, &hi);
+    i = lo;
+#ifdef __SSE2__
+    if (nontemporal) {
+      __m128d vs = _mm_set1_pd(s);
+      for (; i + 1 < hi; i += 2)
+        _mm_stream_pd(&b[i], _mm_mul_pd(vs, _mm_load_pd(&c[i])));
+      _mm_sfence();
+    }
+#endif
+    for (; i < hi; i++)
+      b[i] = s * c[i];
+  }
+}
+
+// Same computation as addvec_kernel, with optional streaming stores
+void stream_add(size_t n, double c[n], double a[n], double b[n], bool nontemporal) {
+  #pragma omp parallel
+  {
+    size_t lo, hi, i = 0;
+    thread_range(n, &lo, &hi);
+    i = lo;
+#ifdef __SSE2__
+    if (nontemporal) {
+      for (; i + 1 < hi; i += 2)
+        _mm_stream_pd(&c[i], _mm_add_pd(_mm_load_pd(&a[i]), _mm_load_pd(&b[i])));
+      _mm_sfence();
+    }
+#endif
+    for (; i < hi; i++)
+      c[i] = a[i] + b[i];
+  }
+}
+
+void stream_triad(size_t n, double a[n], double b[n], double c[n], double s, bool nontemporal) {
+  #pragma omp parallel
+  {
+    size_t lo, hi, i = 0;
+    thread_range(n, &lo, &hi);
+    i = lo;
+#ifdef __SSE2__
+    if (nontemporal) {
+      __m128d vs = _mm_set1_pd(s);
+      for (; i + 1 < hi; i += 2)
+        _mm_stream_pd(&a[i], _mm_add_pd(_mm_load_pd(&b[i]),
+                                        _mm_mul_pd(vs, _mm_load_pd(&c[i]))));
+      _mm_sfence();
+    }
+#endif
+    for (; i < hi; i++)
+      a[i] = b[i] + s * c[i];
+  }
+}
+
+/**
+ * stream_benchmark function:
+ * this function measures the sustainable memory bandwidth (GB/s) of the
+ * four STREAM kernels, for working sets growing by powers of 2 from
+ * STREAM_MIN_BYTES (L1) to max_bytes, and for 1, 2, 4... up to the
+ * maximum number of threads. Each measure repeats the kernel enough times
+ * to move at least STREAM_PASS_BYTES and the best of STREAM_NTIMES is kept.
+ * Streaming stores are used once the working set exceeds the LLC.
+ * Traffic is counted as in STREAM: 2 arrays for copy/scale, 3 for add/triad.
+ * \param max_bytes is the largest working set (3 arrays), 0 for
+ *        STREAM_LLC_FACTOR times the LLC size
+ */
+void stream_benchmark(size_t max_bytes) {
+  long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+  int max_threads = omp_get_max_threads();
+  const char* names[4] = {"Copy", "Scale", "Add", "Triad"};
+  const size_t words[4] = {2, 2, 3, 3};
+
+  if (llc <= 0)
+    llc = sysconf(_SC_LEVEL2_CACHE_SIZE);
+  if (llc <= 0)
+    llc = 8 << 20;
+  if (max_bytes == 0)
+    max_bytes = (size_t)llc * STREAM_LLC_FACTOR;
+  size_t n_max = max_bytes / (3 * sizeof(double));
+  n_max = (n_max + 7) / 8 * 8;
+
+  double* a = aligned_alloc(64, n_max * sizeof(double));
+  double* b = aligned_alloc(64, n_max * sizeof(double));
+  double* c = aligned_alloc(64, n_max * sizeof(double));
+  if (a == NULL || b == NULL || c == NULL) {
+    printf("Not enough memory for a %zu bytes working set\n", max_bytes);
+    exit(1);
+  }
+
+  printf("LLC size ----- : %ld KiB\n", llc >> 10);
+  printf("Max threads -- : %d\n", max_threads);
+  printf("%7s %12s %3s %9s %9s %9s %9s   (GB/s)\n",
+         "Threads", "Set (KiB)", "NT", names[0], names[1], names[2], names[3]);
+
+  for (int nb_threads = 1; ; nb_threads = min(2 * nb_threads, max_threads)) {
+    omp_set_num_threads(nb_threads);
+
+    // First touch with the same partition as the kernels (NUMA placement)
+    #pragma omp parallel
+    {
+      size_t lo, hi;
+      thread_range(n_max, &lo, &hi);
+      for (size_t i = lo; i < hi; i++) {
+        a[i] = 1.;
+        b[i] = 2.;
+        c[i] = 0.;
+      }
+    }
+
+    for (size_t bytes = STREAM_MIN_BYTES; bytes <= max_bytes; bytes *= 2) {
+      size_t n = bytes / (3 * sizeof(double));
+      bool nontemporal = bytes > (size_t)llc;
+      size_t nb_passes = max(1, STREAM_PASS_BYTES / bytes);
+      double best[4] = {1.e30, 1.e30, 1.e30, 1.e30};
+
+      for (int t = 0; t < STREAM_NTIMES; t++) {
+        for (int k = 0; k < 4; k++) {
+          double time = omp_get_wtime();
+          for (size_t p = 0; p < nb_passes; p++) {
+            switch (k) {
+              case 0: stream_copy(n, c, a, nontemporal); break;
+              case 1: stream_scale(n, b, c, STREAM_SCALAR, nontemporal); break;
+              case 2: stream_add(n, c, a, b, nontemporal); break;
+              case 3: stream_triad(n, a, b, c, STREAM_SCALAR, nontemporal); break;
+            }
+          }
+          time = (omp_get_wtime() - time) / nb_passes;
+          best[k] = min(best[k], time);
+        }
+      }
+
+      printf("%7d %12zu %3s", nb_threads, bytes >> 10, nontemporal ? "yes" : "no");
+      for (int k = 0; k < 4; k++)
+        printf(" %9.2lf", words[k] * n * sizeof(double) / best[k] * 1.e-9);
+      printf("\n");
+    }
+    if (nb_threads == max_threads)
+      break;
+  }
+
+  free(a);
+  free(b);
+  free(c);
+}
+
+int main(int argc, char* argv[]) {
+  // Bandwidth benchmark mode: tp1_3_addvec stream [max working set in MiB]
+  if (argc > 1 && strcmp(argv[1], "stream") == 0) {
+    stream_benchmark(argc > 2 ? (size_t)atol(argv[2]) << 20 : 0);
+    return 0;
+  }
+
   double* a   = malloc(N * sizeof(double));
   double* b   = malloc(N * sizeof(double));
   double* c   = malloc(N * sizeof(double));
   double* ref = malloc(N * sizeof(double));
+  double* d   = malloc(N * sizeof(double));
+  double* e   = malloc(N * sizeof(double));
+  double* f   = malloc(N * sizeof(double));
   double time_reference, time_kernel, speedup, efficiency;
+  double time_separate, time_fused;
 
   // Initialization by random values
   srand((unsigned int)time(NULL));
   for (size_t i = 0; i < N; i++) {
     a[i] = (float)rand()/(float)(RAND_MAX/MAX_VAL);
     b[i] = (float)rand()/(float)(RAND_MAX/MAX_VAL);
+    e[i] = (float)rand()/(float)(RAND_MAX/MAX_VAL);
   }
 
   time_reference = omp_get_wtime();
@@ -44,7 +420,7 @@ int main() {
   printf("Reference time : %3.5lf s\n", time_reference);
 
   time_kernel = omp_get_wtime();
-  addvec_kernel(c, a, b);
+  addvec_kernel(N, c, a, b);
   time_kernel = omp_get_wtime() - time_kernel;
   printf("Kernel time -- : %3.5lf s\n", time_kernel);
 
@@ -62,9 +438,39 @@ int main() {
   }
   printf("OK results :-)\n");
 
+  // Chained operations c = a + b; d = c * s + e: separate passes vs fused
+  time_separate = omp_get_wtime();
+  vec_add(N, c, a, b);
+  vec_axpy(N, d, c, MAX_VAL, e);
+  time_separate = omp_get_wtime() - time_separate;
+  printf("Separate time  : %3.5lf s\n", time_separate);
+
+  vop_pipeline p;
+  vop_init(&p, N);
+  int va = vop_vector(&p, a), vb = vop_vector(&p, b), ve = vop_vector(&p, e);
+  int vc = vop_vector(&p, NULL), vf = vop_vector(&p, f);
+  vop_add(&p, vc, va, vb);
+  vop_axpy(&p, vf, vc, MAX_VAL, ve);
+  time_fused = omp_get_wtime();
+  vop_run(&p);
+  time_fused = omp_get_wtime() - time_fused;
+  printf("Fused time --- : %3.5lf s\n", time_fused);
+  printf("Fusion speedup : %3.5lf\n", time_separate / time_fused);
+
+  for (size_t i = 0; i < N; i++) {
+    if (d[i] != f[i]) {
+      printf("Bad fused results :-(((\n");
+      exit(1);
+    }
+  }
+  printf("OK fused results :-)\n");
+
   free(a);
   free(b);
   free(c);
+  free(d);
+  free(e);
+  free(f);
   free(ref);
   return 0;
 }
@@ -1,10 +1,20 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 #include <time.h>
 #include <omp.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86 1
+#endif
+#define min(x, y) ((x) < (y) ? (x) : (y))
 #define HYPERTHREADING 1      // 1 if hyperthreading is on, 0 otherwise
 #define ERROR          1.e-20 // Acceptable precision
 #define MAX_VAL        5      // Random values are [0, MAX_VAL]
+#define REPRO_BLOCK    4096   // Block size of the reproducible sum (elements)
+#define REPRO_LEAF     8      // Leaf size of the pairwise summation tree
+#define SIMD_ERROR     1.e-10 // Acceptable relative precision of reordered sums
 
 // Matrix and vector sizes (5120: UHD TV)
 #define N 5120000
@@ -23,17 +33,213 @@ void sum_reference(double* psum, double a[N]) {
 void sum_kernel(double* psum, double a[N]) {
   double sum = 0.;
 
+  #pragma omp parallel for reduction(+:sum) schedule(static)
   for (size_t i = 0; i < N; i++) {
     sum += a[i];
   }
   *psum = sum;
 }
 
+/**
+ * block_sum function:
+ * this function returns the sum of n elements using 8 interleaved
+ * accumulators combined in a fixed order. The order of the operations only
+ * depends on n, never on the threads, and the independent accumulators
+ * break the dependency chain of the sequential sum.
+ */
+static double block_sum(size_t n, double a[n]) {
+  double acc[8] = {0., 0., 0., 0., 0., 0., 0., 0.};
+  size_t i;
+
+  for (i = 0; i + 8 <= n; i += 8)
+    for (size_t k = 0; k < 8; k++)
+      acc[k] += a[i + k];
+  for (size_t k = 0; i < n; i++, k++)
+    acc[k] += a[i];
+
+  return ((acc[0] + acc[1]) + (acc[2] + acc[3])) +
+         ((acc[4] + acc[5]) + (acc[6] + acc[7]));
+}
+
+/**
+ * pairwise_sum function:
+ * this function returns the sum of n elements with a pairwise (binary tree)
+ * summation: the tree shape only depends on n, the error bound grows in
+ * O(log n) instead of O(n) for the sequential sum.
+ */
+static double pairwise_sum(size_t n, double a[n]) {
+  if (n <= REPRO_LEAF) {
+    double sum = 0.;
+    for (size_t i = 0; i < n; i++)
+      sum += a[i];
+    return sum;
+  }
+  size_t half = n / 2;
+  return pairwise_sum(half, a) + pairwise_sum(n - half, a + half);
+}
+
+/**
+ * sum_reproducible function:
+ * this function computes the sum of n elements with a result that is
+ * bitwise identical whatever the number of threads and the schedule.
+ * The array is cut in fixed blocks of REPRO_BLOCK elements (the cut does
+ * not depend on the threads), each block is summed by block_sum in any
+ * thread, then the block sums are combined with a pairwise tree.
+ * The extra cost over a plain reduction is one write and one read per
+ * block, i.e. n / REPRO_BLOCK elements.
+ * \param psum is the target sum
+ * \param n    is the number of elements
+ * \param a    is the array to sum
+ */
+void sum_reproducible(double* psum, size_t n, double a[n]) {
+  size_t nb_blocks = (n + REPRO_BLOCK - 1) / REPRO_BLOCK;
+  double* partial = malloc(nb_blocks * sizeof(double));
+
+  #pragma omp parallel for schedule(static)
+  for (size_t k = 0; k < nb_blocks; k++) {
+    size_t start = k * REPRO_BLOCK;
+    partial[k] = block_sum(min(REPRO_BLOCK, n - start), a + start);
+  }
+
+  *psum = pairwise_sum(nb_blocks, partial);
+  free(partial);
+}
+
+/**
+ * sum_simd_* functions:
+ * these functions return the sum of n elements using 4 independent vector
+ * accumulators, so that 4 vector additions are in flight at once instead of
+ * one scalar addition per FP add latency. Each variant is compiled for its
+ * own instruction set (target attribute), the binary stays runnable on any
+ * x86-64 and sum_simd_init selects the best one the CPU supports.
+ */
+static double sum_simd_scalar(size_t n, double a[n]) {
+  double acc0 = 0., acc1 = 0., acc2 = 0., acc3 = 0.;
+  size_t i;
+
+  for (i = 0; i + 4 <= n; i += 4) {
+    acc0 += a[i];
+    acc1 += a[i + 1];
+    acc2 += a[i + 2];
+    acc3 += a[i + 3];
+  }
+  for (; i < n; i++)
+    acc0 += a[i];
+  return (acc0 + acc1) + (acc2 + acc3);
+}
+
+#ifdef SIMD_X86
+__attribute__((target("sse2")))
+static double sum_simd_sse2(size_t n, double a[n]) {
+  __m128d acc0 = _mm_setzero_pd(), acc1 = _mm_setzero_pd();
+  __m128d acc2 = _mm_setzero_pd(), acc3 = _mm_setzero_pd();
+  size_t i;
+
+  for (i = 0; i + 8 <= n; i += 8) {
+    acc0 = _mm_add_pd(acc0, _mm_loadu_pd(&a[i]));
+    acc1 = _mm_add_pd(acc1, _mm_loadu_pd(&a[i + 2]));
+    acc2 = _mm_add_pd(acc2, _mm_loadu_pd(&a[i + 4]));
+    acc3 = _mm_add_pd(acc3, _mm_loadu_pd(&a[i + 6]));
+  }
+  acc0 = _mm_add_pd(_mm_add_pd(acc0, acc1), _mm_add_pd(acc2, acc3));
+  double sum = _mm_cvtsd_f64(_mm_add_sd(acc0, _mm_unpackhi_pd(acc0, acc0)));
+  for (; i < n; i++)
+    sum += a[i];
+  return sum;
+}
+
+__attribute__((target("avx2")))
+static double sum_simd_avx2(size_t n, double a[n]) {
+  __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+  __m256d acc2 = _mm256_setzero_pd(), acc3 = _mm256_setzero_pd();
+  size_t i;
+
+  for (i = 0; i + 16 <= n; i += 16) {
+    acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(&a[i]));
+    acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(&a[i + 4]));
+    acc2 = _mm256_add_pd(acc2, _mm256_loadu_pd(&a[i + 8]));
+    acc3 = _mm256_add_pd(acc3, _mm256_loadu_pd(&a[i + 12]));
+  }
+  acc0 = _mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3));
+  __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc0), _mm256_extractf128_pd(acc0, 1));
+  double sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+  for (; i < n; i++)
+    sum += a[i];
+  return sum;
+}
+
+__attribute__((target("avx512f")))
+static double sum_simd_avx512(size_t n, double a[n]) {
+  __m512d acc0 = _mm512_setzero_pd(), acc1 = _mm512_setzero_pd();
+  __m512d acc2 = _mm512_setzero_pd(), acc3 = _mm512_setzero_pd();
+  size_t i;
+
+  for (i = 0; i + 32 <= n; i += 32) {
+    acc0 = _mm512_add_pd(acc0, _mm512_loadu_pd(&a[i]));
+    acc1 = _mm512_add_pd(acc1, _mm512_loadu_pd(&a[i + 8]));
+    acc2 = _mm512_add_pd(acc2, _mm512_loadu_pd(&a[i + 16]));
+    acc3 = _mm512_add_pd(acc3, _mm512_loadu_pd(&a[i + 24]));
+  }
+  acc0 = _mm512_add_pd(_mm512_add_pd(acc0, acc1), _mm512_add_pd(acc2, acc3));
+  double sum = _mm512_reduce_add_pd(acc0);
+  for (; i < n; i++)
+    sum += a[i];
+  return sum;
+}
+#endif
+
+static double (*sum_simd)(size_t n, double a[n]) = sum_simd_scalar;
+static const char* sum_simd_isa = "scalar";
+
+/**
+ * sum_simd_init function:
+ * this function selects the best sum_simd_* variant for the running CPU.
+ * __builtin_cpu_supports reads CPUID (and checks that the OS saves the
+ * vector registers), it must be called once at startup.
+ */
+void sum_simd_init(void) {
+#ifdef SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    sum_simd = sum_simd_avx512;
+    sum_simd_isa = "avx512";
+  } else if (__builtin_cpu_supports("avx2")) {
+    sum_simd = sum_simd_avx2;
+    sum_simd_isa = "avx2";
+  } else if (__builtin_cpu_supports("sse2")) {
+    sum_simd = sum_simd_sse2;
+    sum_simd_isa = "sse2";
+  }
+#endif
+}
+
+/**
+ * sum_simd_kernel function:
+ * this function computes the sum of n elements, each thread summing its
+ * contiguous slice with the selected SIMD variant before an OpenMP
+ * reduction of the per-thread results.
+ */
+void sum_simd_kernel(double* psum, size_t n, double a[n]) {
+  double sum = 0.;
+
+  #pragma omp parallel reduction(+:sum)
+  {
+    size_t nb_threads = omp_get_num_threads();
+    size_t tid = omp_get_thread_num();
+    size_t lo = n * tid / nb_threads;
+    size_t hi = n * (tid + 1) / nb_threads;
+    sum += sum_simd(hi - lo, a + lo);
+  }
+  *psum = sum;
+}
+
 int main() {
   double* a = malloc(N * sizeof(double));
   double ref, sum;
   double time_reference, time_kernel, speedup, efficiency;
 
+  sum_simd_init();
+
   // Initialization by random values
   srand((unsigned int)time(NULL));
   for (size_t i = 0; i < N; i++) {
@@ -56,12 +262,61 @@ int main() {
   printf("Efficiency --- : %3.5lf\n", efficiency);
 
   // Check if the result differs from the reference
-  if (abs(ref - sum) > ERROR) {
+  if (fabs(ref - sum) > SIMD_ERROR * fabs(ref)) {
     printf("Bad results :-(((\n");
     exit(1);
   }
   printf("OK results :-)\n");
 
+  // Reproducible mode: same bits for any number of threads
+  double repro, repro_nt, time_repro;
+  int max_threads = omp_get_max_threads();
+
+  time_repro = omp_get_wtime();
+  sum_reproducible(&repro, N, a);
+  time_repro = omp_get_wtime() - time_repro;
+  printf("Repro time --- : %3.5lf s\n", time_repro);
+  printf("Repro / kernel : %3.5lf\n", time_repro / time_kernel);
+  printf("Repro - ref -- : %.3lg\n", repro - ref);
+
+  for (int nb_threads = 1; nb_threads <= 2 * max_threads; nb_threads++) {
+    omp_set_num_threads(nb_threads);
+    sum_reproducible(&repro_nt, N, a);
+    if (memcmp(&repro, &repro_nt, sizeof(double)) != 0) {
+      printf("Bad reproducible results with %d threads :-(((\n", nb_threads);
+      exit(1);
+    }
+  }
+  omp_set_num_threads(max_threads);
+  printf("OK reproducible results (1 to %d threads) :-)\n", 2 * max_threads);
+
+  // SIMD mode: one thread (per core speedup), then all threads
+  double simd, time_simd;
+
+  omp_set_num_threads(1);
+  time_simd = omp_get_wtime();
+  sum_simd_kernel(&simd, N, a);
+  time_simd = omp_get_wtime() - time_simd;
+  omp_set_num_threads(max_threads);
+  printf("SIMD ISA ----- : %s\n", sum_simd_isa);
+  printf("SIMD 1 thread  : %3.5lf s (speedup %3.5lf)\n",
+         time_simd, time_reference / time_simd);
+  if (fabs(ref - simd) > SIMD_ERROR * fabs(ref)) {
+    printf("Bad SIMD results :-(((\n");
+    exit(1);
+  }
+
+  time_simd = omp_get_wtime();
+  sum_simd_kernel(&simd, N, a);
+  time_simd = omp_get_wtime() - time_simd;
+  printf("SIMD %2d threads: %3.5lf s (speedup %3.5lf)\n",
+         max_threads, time_simd, time_reference / time_simd);
+  if (fabs(ref - simd) > SIMD_ERROR * fabs(ref)) {
+    printf("Bad SIMD results :-(((\n");
+    exit(1);
+  }
+  printf("OK SIMD results :-)\n");
+
   free(a);
   return 0;
 }
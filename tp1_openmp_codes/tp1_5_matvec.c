@@ -1,11 +1,31 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
 #include <time.h>
 #include <omp.h>
+#define min(x, y) ((x) < (y) ? (x) : (y))
 #define HYPERTHREADING 1 // 1 if hyperthreading is on, 0 otherwise
 #define ERROR 1.e-20     // Acceptable precision
+#define REL_ERROR 1.e-12 // Acceptable relative precision (reordered sums)
+#define FLOAT_ERROR 0x1p-23 // Acceptable relative error, float storage (2 x 2^-24)
+#define BF16_ERROR (0x1p-8 + 0x1p-23) // Same, bf16 storage (2^-8 + float rounding)
 #define MAX_VAL 5        // Random values are [0, MAX_VAL]
 
+// Batched matvec parameters
+#define K 16         // Number of right-hand side vectors
+#define MV_ROWS 4    // Rows of A per register tile
+#define MV_VECS 8    // Vectors per register tile (one AVX-512 register)
+#define MV_COLS 256  // Columns of A per cache block (B panel: MV_COLS x k)
+
+// Sparse matvec parameters
+#define SELL_C 8         // Rows per SELL chunk (SIMD width)
+#define SELL_SIGMA 256   // Sorting window of SELL rows (multiple of SELL_C)
+#define SPARSE_DENSITY 0.01 // Ratio of nonzeros of the generated matrices
+#define SPARSE_REPEAT 20 // Products per sparse timing (the mean is printed)
+
 // Matrix and vector sizes (5120: UHD TV)
 #define N 5120
 
@@ -28,7 +48,7 @@ void matvec_reference(double c[N], double A[N][N], double b[N])
 void matvec_kernel(double c[N], double A[N][N], double b[N])
 {
   size_t i, j;
-  #pragma omp parallel private(i,j) shared(A,b) num_threads(10)
+  #pragma omp parallel private(i,j) shared(A,b)
   {
     #pragma omp for schedule(static)
     for (i = 0; i < N; i++)
@@ -42,6 +62,436 @@ void matvec_kernel(double c[N], double A[N][N], double b[N])
   }
 }
 
+/**
+ * matvec_tile function:
+ * this function accumulates the contribution of columns [j0, j1) of rows
+ * [i, i + rows) of A to the vectors [v, v + vecs) of C. The rows x vecs
+ * accumulators are kept in registers, each element of A loaded once is
+ * used for vecs vectors. Called with the constants MV_ROWS and MV_VECS for
+ * full tiles so that the loops are unrolled and vectorized.
+ */
+static inline void matvec_tile(size_t n, size_t k, double C[n][k], double A[n][n],
+                               double B[n][k], size_t i, size_t v, size_t j0,
+                               size_t j1, size_t rows, size_t vecs)
+{
+  double acc[MV_ROWS][MV_VECS];
+
+  for (size_t r = 0; r < rows; r++)
+    for (size_t w = 0; w < vecs; w++)
+      acc[r][w] = C[i + r][v + w];
+
+  for (size_t j = j0; j < j1; j++)
+  {
+    for (size_t r = 0; r < rows; r++)
+    {
+      double a = A[i + r][j];
+      #pragma omp simd
+      for (size_t w = 0; w < vecs; w++)
+        acc[r][w] += a * B[j][v + w];
+    }
+  }
+
+  for (size_t r = 0; r < rows; r++)
+    for (size_t w = 0; w < vecs; w++)
+      C[i + r][v + w] = acc[r][w];
+}
+
+/**
+ * matvec_batch_kernel function:
+ * this function computes k products c = A.b with the same matrix in a
+ * single pass over A. The k vectors are interleaved: B[j][v] is the
+ * element j of the vector v (B is n x k, row-major), same for C.
+ * Rows of A are distributed over the threads by blocks of MV_ROWS; for a
+ * block, columns are processed by chunks of MV_COLS so that the A block
+ * (MV_ROWS x MV_COLS) stays in L1 and the B panel (MV_COLS x k) in L2
+ * while all the vector tiles are computed.
+ * \param n is the size of the matrix
+ * \param k is the number of vectors
+ * \param C is the result (n x k)
+ * \param A is the matrix (n x n)
+ * \param B is the vectors (n x k)
+ */
+void matvec_batch_kernel(size_t n, size_t k, double C[n][k], double A[n][n], double B[n][k])
+{
+  size_t nb_row_blocks = (n + MV_ROWS - 1) / MV_ROWS;
+
+  #pragma omp parallel for schedule(static)
+  for (size_t ib = 0; ib < nb_row_blocks; ib++)
+  {
+    size_t i = ib * MV_ROWS;
+    size_t rows = min(MV_ROWS, n - i);
+
+    for (size_t r = 0; r < rows; r++)
+      for (size_t v = 0; v < k; v++)
+        C[i + r][v] = 0.;
+
+    for (size_t j0 = 0; j0 < n; j0 += MV_COLS)
+    {
+      size_t j1 = min(j0 + MV_COLS, n);
+      for (size_t v = 0; v < k; v += MV_VECS)
+      {
+        size_t vecs = min(MV_VECS, k - v);
+        if (rows == MV_ROWS && vecs == MV_VECS)
+          matvec_tile(n, k, C, A, B, i, v, j0, j1, MV_ROWS, MV_VECS);
+        else
+          matvec_tile(n, k, C, A, B, i, v, j0, j1, rows, vecs);
+      }
+    }
+  }
+}
+
+/**
+ * Mixed precision:
+ * the matrix is stored in a narrow format (float, or bf16: the upper 16
+ * bits of a float, kept in a uint16_t) to move 2 or 4 times less bytes,
+ * while the products are accumulated in double. With nonnegative values,
+ * the relative error of each c[i] is bounded by the rounding of A.
+ */
+static inline uint16_t double_to_bf16(double x)
+{
+  float f = (float)x;
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+  bits += 0x7FFF + ((bits >> 16) & 1); // Round to nearest even
+  return (uint16_t)(bits >> 16);
+}
+
+static inline double bf16_to_double(uint16_t h)
+{
+  uint32_t bits = (uint32_t)h << 16;
+  float f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+void dense_to_float(size_t n, float F[n][n], double A[n][n])
+{
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; i++)
+    for (size_t j = 0; j < n; j++)
+      F[i][j] = (float)A[i][j];
+}
+
+void dense_to_bf16(size_t n, uint16_t H[n][n], double A[n][n])
+{
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; i++)
+    for (size_t j = 0; j < n; j++)
+      H[i][j] = double_to_bf16(A[i][j]);
+}
+
+// c = A.b with A stored in float, accumulated in double
+void matvec_float_kernel(size_t n, double c[n], float A[n][n], double b[n])
+{
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; i++)
+  {
+    double sum = 0.;
+    #pragma omp simd reduction(+:sum)
+    for (size_t j = 0; j < n; j++)
+      sum += (double)A[i][j] * b[j];
+    c[i] = sum;
+  }
+}
+
+// c = A.b with A stored in bf16, accumulated in double
+void matvec_bf16_kernel(size_t n, double c[n], uint16_t A[n][n], double b[n])
+{
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; i++)
+  {
+    double sum = 0.;
+    #pragma omp simd reduction(+:sum)
+    for (size_t j = 0; j < n; j++)
+      sum += bf16_to_double(A[i][j]) * b[j];
+    c[i] = sum;
+  }
+}
+
+// Returns the maximum of |ref[i] - c[i]| / |ref[i]|
+double max_relative_error(size_t n, double ref[n], double c[n])
+{
+  double error = 0.;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    double e = fabs(ref[i] - c[i]);
+    if (ref[i] != 0.)
+      e /= fabs(ref[i]);
+    if (e > error)
+      error = e;
+  }
+  return error;
+}
+
+/**
+ * Sparse matrices:
+ * csr_matrix is the Compressed Sparse Row format: the nonzeros of row i
+ * are val[row_ptr[i] .. row_ptr[i + 1] - 1], in columns col[...].
+ * sell_matrix is the SELL-C-sigma format: rows are sorted by decreasing
+ * length inside windows of SELL_SIGMA rows (perm[r] is the original row of
+ * the sorted row r), then cut in chunks of SELL_C rows. A chunk is stored
+ * column-major and padded to its longest row: element j of the row r of
+ * chunk k is val[chunk_ptr[k] + j * SELL_C + r], so SELL_C rows are
+ * processed together in SIMD lanes with little padding.
+ */
+typedef struct
+{
+  size_t n;
+  size_t nnz;
+  size_t *row_ptr;
+  uint32_t *col;
+  double *val;
+} csr_matrix;
+
+typedef struct
+{
+  size_t n;
+  size_t nb_chunks;
+  size_t *chunk_ptr; // nb_chunks + 1 offsets, in elements
+  size_t *perm;
+  uint32_t *col;
+  double *val;
+} sell_matrix;
+
+/**
+ * dense_to_csr function:
+ * this function converts a dense n x n matrix to CSR (rows are counted,
+ * then filled, in parallel).
+ */
+void dense_to_csr(csr_matrix *S, size_t n, double A[n][n])
+{
+  S->n = n;
+  S->row_ptr = malloc((n + 1) * sizeof(size_t));
+
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; i++)
+  {
+    size_t count = 0;
+    for (size_t j = 0; j < n; j++)
+      count += (A[i][j] != 0.);
+    S->row_ptr[i + 1] = count;
+  }
+
+  S->row_ptr[0] = 0;
+  for (size_t i = 0; i < n; i++)
+    S->row_ptr[i + 1] += S->row_ptr[i];
+  S->nnz = S->row_ptr[n];
+  S->col = malloc(S->nnz * sizeof(uint32_t));
+  S->val = malloc(S->nnz * sizeof(double));
+
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; i++)
+  {
+    size_t p = S->row_ptr[i];
+    for (size_t j = 0; j < n; j++)
+    {
+      if (A[i][j] != 0.)
+      {
+        S->col[p] = (uint32_t)j;
+        S->val[p] = A[i][j];
+        p++;
+      }
+    }
+  }
+}
+
+void csr_free(csr_matrix *S)
+{
+  free(S->row_ptr);
+  free(S->col);
+  free(S->val);
+}
+
+/**
+ * balanced_range function:
+ * this function gives the calling thread the items [lo, hi) such that all
+ * threads get about the same weight, ptr being the n + 1 prefix sums of the
+ * item weights (row_ptr or chunk_ptr). Items are never split.
+ */
+static void balanced_range(size_t n, size_t ptr[n + 1], size_t *lo, size_t *hi)
+{
+  size_t nb_threads = omp_get_num_threads();
+  size_t tid = omp_get_thread_num();
+  size_t bounds[2];
+
+  for (size_t b = 0; b < 2; b++)
+  {
+    size_t target = ptr[n] / nb_threads * (tid + b) +
+                    ptr[n] % nb_threads * (tid + b) / nb_threads;
+    size_t first = 0, last = n; // First item whose start reaches target
+    while (first < last)
+    {
+      size_t mid = (first + last) / 2;
+      if (ptr[mid] < target)
+        first = mid + 1;
+      else
+        last = mid;
+    }
+    bounds[b] = first;
+  }
+  *lo = (tid == 0) ? 0 : bounds[0];
+  *hi = (tid == nb_threads - 1) ? n : bounds[1];
+}
+
+// c = S.b, threads get about the same number of nonzeros
+void csr_matvec(double *c, csr_matrix *S, double *b)
+{
+  #pragma omp parallel
+  {
+    size_t lo, hi;
+    balanced_range(S->n, S->row_ptr, &lo, &hi);
+    for (size_t i = lo; i < hi; i++)
+    {
+      double sum = 0.;
+      for (size_t p = S->row_ptr[i]; p < S->row_ptr[i + 1]; p++)
+        sum += S->val[p] * b[S->col[p]];
+      c[i] = sum;
+    }
+  }
+}
+
+typedef struct
+{
+  size_t length, row;
+} sell_row;
+
+// Longest rows first, ties by row index (stable, reentrant)
+static int sell_compare(const void *x, const void *y)
+{
+  const sell_row *rx = x, *ry = y;
+  if (rx->length != ry->length)
+    return (rx->length < ry->length) ? 1 : -1;
+  return (rx->row > ry->row) - (rx->row < ry->row);
+}
+
+/**
+ * csr_to_sell function:
+ * this function converts a CSR matrix to SELL-C-sigma (C = SELL_C,
+ * sigma = SELL_SIGMA). Padding elements have a 0 value and column 0.
+ */
+void csr_to_sell(sell_matrix *T, csr_matrix *S)
+{
+  size_t n = S->n;
+  size_t *lengths = malloc(n * sizeof(size_t));
+  sell_row *rows = malloc(n * sizeof(sell_row));
+
+  T->n = n;
+  T->nb_chunks = (n + SELL_C - 1) / SELL_C;
+  T->perm = malloc(T->nb_chunks * SELL_C * sizeof(size_t));
+  T->chunk_ptr = malloc((T->nb_chunks + 1) * sizeof(size_t));
+
+  for (size_t i = 0; i < n; i++)
+  {
+    lengths[i] = S->row_ptr[i + 1] - S->row_ptr[i];
+    rows[i].length = lengths[i];
+    rows[i].row = i;
+  }
+  for (size_t w = 0; w < n; w += SELL_SIGMA)
+    qsort(rows + w, min(SELL_SIGMA, n - w), sizeof(sell_row), sell_compare);
+  for (size_t i = 0; i < n; i++)
+    T->perm[i] = rows[i].row;
+  free(rows);
+
+  // Padding rows of the last chunk are empty, they map to no row
+  for (size_t r = n; r < T->nb_chunks * SELL_C; r++)
+    T->perm[r] = n;
+
+  T->chunk_ptr[0] = 0;
+  for (size_t k = 0; k < T->nb_chunks; k++)
+  {
+    size_t width = lengths[T->perm[k * SELL_C]]; // Sorted: first is longest
+    T->chunk_ptr[k + 1] = T->chunk_ptr[k] + width * SELL_C;
+  }
+  T->col = malloc(T->chunk_ptr[T->nb_chunks] * sizeof(uint32_t));
+  T->val = malloc(T->chunk_ptr[T->nb_chunks] * sizeof(double));
+
+  #pragma omp parallel for schedule(static)
+  for (size_t k = 0; k < T->nb_chunks; k++)
+  {
+    size_t width = (T->chunk_ptr[k + 1] - T->chunk_ptr[k]) / SELL_C;
+    for (size_t r = 0; r < SELL_C; r++)
+    {
+      size_t row = T->perm[k * SELL_C + r];
+      size_t len = (row < n) ? lengths[row] : 0;
+      for (size_t j = 0; j < width; j++)
+      {
+        size_t q = T->chunk_ptr[k] + j * SELL_C + r;
+        T->col[q] = (j < len) ? S->col[S->row_ptr[row] + j] : 0;
+        T->val[q] = (j < len) ? S->val[S->row_ptr[row] + j] : 0.;
+      }
+    }
+  }
+  free(lengths);
+}
+
+void sell_free(sell_matrix *T)
+{
+  free(T->chunk_ptr);
+  free(T->perm);
+  free(T->col);
+  free(T->val);
+}
+
+// c = T.b, threads get about the same number of stored elements
+void sell_matvec(double *c, sell_matrix *T, double *b)
+{
+  #pragma omp parallel
+  {
+    size_t lo, hi;
+    balanced_range(T->nb_chunks, T->chunk_ptr, &lo, &hi);
+    for (size_t k = lo; k < hi; k++)
+    {
+      double sum[SELL_C] = {0.};
+      size_t width = (T->chunk_ptr[k + 1] - T->chunk_ptr[k]) / SELL_C;
+      double *val = T->val + T->chunk_ptr[k];
+      uint32_t *col = T->col + T->chunk_ptr[k];
+
+      for (size_t j = 0; j < width; j++)
+      {
+        #pragma omp simd
+        for (size_t r = 0; r < SELL_C; r++)
+          sum[r] += val[j * SELL_C + r] * b[col[j * SELL_C + r]];
+      }
+      for (size_t r = 0; r < SELL_C; r++)
+        if (T->perm[k * SELL_C + r] < T->n)
+          c[T->perm[k * SELL_C + r]] = sum[r];
+    }
+  }
+}
+
+/**
+ * generate_sparse function:
+ * this function fills a dense n x n matrix with about density * n * n
+ * random nonzeros following a pattern:
+ * 0 uniform: every element is nonzero with probability density,
+ * 1 banded: nonzeros in a band of density * n elements around the diagonal,
+ * 2 skewed: one row in 100 is half full, the others share the rest
+ *   (load imbalance for a row-count partition).
+ */
+void generate_sparse(size_t n, double A[n][n], int pattern)
+{
+  size_t half_band = (size_t)(SPARSE_DENSITY * n / 2);
+  double p_heavy = 0.5;
+  double p_light = (SPARSE_DENSITY * 100 - p_heavy) / 99;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    for (size_t j = 0; j < n; j++)
+    {
+      double p = (double)rand() / RAND_MAX;
+      bool nonzero;
+      if (pattern == 0)
+        nonzero = p < SPARSE_DENSITY;
+      else if (pattern == 1)
+        nonzero = (i <= j + half_band) && (j <= i + half_band);
+      else
+        nonzero = p < ((i % 100 == 0) ? p_heavy : p_light);
+      A[i][j] = nonzero ? 1 + (float)rand() / (float)(RAND_MAX / MAX_VAL) : 0.;
+    }
+  }
+}
+
 int main()
 {
   double *A = malloc(N * N * sizeof(double));
@@ -54,8 +504,8 @@ int main()
   srand((unsigned int)time(NULL));
   for (size_t i = 0; i < N; i++)
     b[i] = (float)rand() / (float)(RAND_MAX / MAX_VAL);
-  for (size_t i = 0; i < N * N; i++)
-    A[i] = (float)rand() / (float)(RAND_MAX / MAX_VAL);
+  for (size_t i = 0; i < N * N; i++) // Full double precision: float storage rounds
+    A[i] = (double)rand() / RAND_MAX * MAX_VAL;
 
   time_reference = omp_get_wtime();
   matvec_reference(ref, (double(*)[N])A, b);
@@ -84,9 +534,141 @@ int main()
   }
   printf("OK results :-)\n");
 
+  // Batched mode: K vectors, one call per vector vs one pass over A
+  double *B = malloc(N * K * sizeof(double));
+  double *C = malloc(N * K * sizeof(double));
+  double time_single, time_batch;
+
+  for (size_t i = 0; i < N * K; i++)
+    B[i] = (float)rand() / (float)(RAND_MAX / MAX_VAL);
+
+  time_single = omp_get_wtime();
+  for (size_t v = 0; v < K; v++)
+  {
+    for (size_t j = 0; j < N; j++)
+      b[j] = B[j * K + v];
+    matvec_kernel(c, (double(*)[N])A, b);
+    for (size_t i = 0; i < N; i++)
+      C[i * K + v] = c[i];
+  }
+  time_single = omp_get_wtime() - time_single;
+  printf("%d x kernel -- : %3.5lf s\n", K, time_single);
+
+  time_batch = omp_get_wtime();
+  matvec_batch_kernel(N, K, (double(*)[K])C, (double(*)[N])A, (double(*)[K])B);
+  time_batch = omp_get_wtime() - time_batch;
+  printf("Batch kernel - : %3.5lf s\n", time_batch);
+  printf("Batch speedup  : %3.5lf\n", time_single / time_batch);
+
+  for (size_t v = 0; v < K; v++)
+  {
+    for (size_t j = 0; j < N; j++)
+      b[j] = B[j * K + v];
+    matvec_reference(ref, (double(*)[N])A, b);
+    for (size_t i = 0; i < N; i++)
+    {
+      if (fabs(ref[i] - C[i * K + v]) > REL_ERROR * fabs(ref[i]))
+      {
+        printf("Bad batch results :-(((\n");
+        exit(1);
+      }
+    }
+  }
+  printf("OK batch results :-)\n");
+
+  // Mixed precision mode: narrow storage, double accumulation
+  float *AF = malloc(N * N * sizeof(float));
+  uint16_t *AH = malloc(N * N * sizeof(uint16_t));
+  double time_float, time_bf16, error_float, error_bf16;
+
+  dense_to_float(N, (float(*)[N])AF, (double(*)[N])A);
+  dense_to_bf16(N, (uint16_t(*)[N])AH, (double(*)[N])A);
+  matvec_reference(ref, (double(*)[N])A, b);
+
+  time_float = omp_get_wtime();
+  matvec_float_kernel(N, c, (float(*)[N])AF, b);
+  time_float = omp_get_wtime() - time_float;
+  error_float = max_relative_error(N, ref, c);
+
+  time_bf16 = omp_get_wtime();
+  matvec_bf16_kernel(N, c, (uint16_t(*)[N])AH, b);
+  time_bf16 = omp_get_wtime() - time_bf16;
+  error_bf16 = max_relative_error(N, ref, c);
+
+  printf("Float time --- : %3.5lf s (speedup %3.5lf, max rel. error %.3lg)\n",
+         time_float, time_kernel / time_float, error_float);
+  printf("Bf16 time ---- : %3.5lf s (speedup %3.5lf, max rel. error %.3lg)\n",
+         time_bf16, time_kernel / time_bf16, error_bf16);
+  if ((error_float > FLOAT_ERROR) || (error_bf16 > BF16_ERROR))
+  {
+    printf("Bad mixed precision results :-(((\n");
+    exit(1);
+  }
+  printf("OK mixed precision results :-)\n");
+  free(AF);
+  free(AH);
+
+  // Sparse mode: CSR and SELL-C-sigma against the dense reference
+  const char *patterns[3] = {"uniform", "banded", "skewed"};
+  for (int pattern = 0; pattern < 3; pattern++)
+  {
+    csr_matrix S;
+    sell_matrix T;
+    double time_csr, time_sell;
+
+    generate_sparse(N, (double(*)[N])A, pattern);
+    dense_to_csr(&S, N, (double(*)[N])A);
+    csr_to_sell(&T, &S);
+
+    time_reference = omp_get_wtime();
+    matvec_reference(ref, (double(*)[N])A, b);
+    time_reference = omp_get_wtime() - time_reference;
+
+    time_csr = omp_get_wtime();
+    for (int t = 0; t < SPARSE_REPEAT; t++)
+      csr_matvec(c, &S, b);
+    time_csr = (omp_get_wtime() - time_csr) / SPARSE_REPEAT;
+    for (size_t i = 0; i < N; i++)
+    {
+      if (fabs(ref[i] - c[i]) > REL_ERROR * fabs(ref[i]))
+      {
+        printf("Bad CSR results :-(((\n");
+        exit(1);
+      }
+    }
+
+    time_sell = omp_get_wtime();
+    for (int t = 0; t < SPARSE_REPEAT; t++)
+      sell_matvec(c, &T, b);
+    time_sell = (omp_get_wtime() - time_sell) / SPARSE_REPEAT;
+    for (size_t i = 0; i < N; i++)
+    {
+      if (fabs(ref[i] - c[i]) > REL_ERROR * fabs(ref[i]))
+      {
+        printf("Bad SELL results :-(((\n");
+        exit(1);
+      }
+    }
+
+    printf("Sparse %-8s : nnz %zu (%.2lf%%), CSR %.1lf MB, SELL %.1lf MB, dense %.1lf MB\n",
+           patterns[pattern], S.nnz, 100. * S.nnz / ((double)N * N),
+           S.nnz * (sizeof(double) + sizeof(uint32_t)) * 1.e-6,
+           T.chunk_ptr[T.nb_chunks] * (sizeof(double) + sizeof(uint32_t)) * 1.e-6,
+           N * N * sizeof(double) * 1.e-6);
+    printf("  Reference time : %3.5lf s\n", time_reference);
+    printf("  CSR time ----- : %3.5lf s (speedup %.1lf)\n", time_csr, time_reference / time_csr);
+    printf("  SELL time ---- : %3.5lf s (speedup %.1lf)\n", time_sell, time_reference / time_sell);
+
+    csr_free(&S);
+    sell_free(&T);
+  }
+  printf("OK sparse results :-)\n");
+
   free(A);
   free(b);
   free(c);
+  free(B);
+  free(C);
   free(ref);
   return 0;
 }
@@ -1,9 +1,11 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include <time.h>
 #include <omp.h>
 #define HYPERTHREADING 1 // 1 if hyperthreading is on, 0 otherwise
 #define ERROR 1.e-20     // Acceptable precision
+#define SCAN_ERROR 1.e-10 // Acceptable relative precision (composed affine maps)
 #define MAX_VAL 5        // Random values are [0, MAX_VAL]
 
 // Matrix and vector sizes (5120: UHD TV)
@@ -41,6 +43,122 @@ void stencil1D_kernel(double a[N], double b[N])
   }
 }
 
+/**
+ * Linear recurrence scan:
+ * a first-order linear recurrence x[i] = mul[i] * x[i - 1] + add[i] is a
+ * composition of affine maps, which is associative, so it can be solved as
+ * a parallel prefix scan in three phases:
+ * 1. each thread composes the maps of its chunk of x into (M, K) such that
+ *    x[hi - 1] = M * x[lo - 1] + K (read only),
+ * 2. one thread scans the (M, K) of the chunks to get the value entering
+ *    each chunk,
+ * 3. each thread runs the recurrence over its chunk from that value.
+ * Phases 1 and 3 only read/write the chunk of the thread. When the product
+ * of the multipliers underflows to 0 (|mul| < 1, the recurrence forgets its
+ * past), phase 1 only needs the end of the chunk: the work is then about
+ * n / nb_threads per thread and the result is the one of the sequential
+ * loop. Otherwise phase 1 covers the whole chunk and the result is exact
+ * up to the rounding of the compositions.
+ */
+typedef struct
+{
+  double M, K;
+} affine_map;
+
+/**
+ * linrec_scan_impl function:
+ * common implementation of linrec_scan and linrec_scan_const: when mul is
+ * NULL the multiplier is alpha, when add is NULL the added term is
+ * beta * x[i] (x is then read before being overwritten, in place).
+ */
+static void linrec_scan_impl(size_t n, double x[n], double *mul, double *add,
+                             double alpha, double beta)
+{
+  if (n < 2)
+    return;
+
+  int max_threads = omp_get_max_threads();
+  affine_map *maps = malloc(max_threads * sizeof(affine_map));
+  double *carry = malloc((max_threads + 1) * sizeof(double));
+
+  #pragma omp parallel
+  {
+    size_t nb_threads = omp_get_num_threads();
+    size_t tid = omp_get_thread_num();
+    size_t lo = 1 + (n - 1) * tid / nb_threads;
+    size_t hi = 1 + (n - 1) * (tid + 1) / nb_threads;
+    double m, k, value;
+
+    // Phase 1: start of the useful suffix (influence not underflowed)
+    size_t start = hi;
+    double prod = 1.;
+    while ((start > lo) && (prod != 0.))
+    {
+      start--;
+      prod *= (mul != NULL) ? mul[start] : alpha;
+    }
+    value = 0.;
+    for (size_t i = start; i < hi; i++)
+    {
+      m = (mul != NULL) ? mul[i] : alpha;
+      k = (add != NULL) ? add[i] : beta * x[i];
+      value = m * value + k;
+    }
+    maps[tid].M = prod;
+    maps[tid].K = value;
+
+    // Phase 2: value entering each chunk
+    #pragma omp barrier
+    #pragma omp single
+    {
+      carry[0] = x[0];
+      for (size_t t = 0; t < nb_threads; t++)
+        carry[t + 1] = (maps[t].M == 0.) ? maps[t].K
+                                         : maps[t].M * carry[t] + maps[t].K;
+    }
+
+    // Phase 3: recurrence over the chunk from its entering value
+    value = carry[tid];
+    for (size_t i = lo; i < hi; i++)
+    {
+      m = (mul != NULL) ? mul[i] : alpha;
+      k = (add != NULL) ? add[i] : beta * x[i];
+      value = m * value + k;
+      x[i] = value;
+    }
+  }
+
+  free(maps);
+  free(carry);
+}
+
+/**
+ * linrec_scan function:
+ * this function solves x[i] = mul[i] * x[i - 1] + add[i] for 0 < i < n
+ * in parallel, x[0] being given. add may be x itself.
+ */
+void linrec_scan(size_t n, double x[n], double mul[n], double add[n])
+{
+  linrec_scan_impl(n, x, mul, add, 0., 0.);
+}
+
+/**
+ * linrec_scan_const function:
+ * this function solves x[i] = alpha * x[i - 1] + beta * x[i] for
+ * 0 < i < n in parallel and in place.
+ */
+void linrec_scan_const(size_t n, double x[n], double alpha, double beta)
+{
+  linrec_scan_impl(n, x, NULL, NULL, alpha, beta);
+}
+
+// Scan kernel: a[i] = (a[i] + a[i - 1]) / 2 is alpha = beta = 1/2
+void stencil1D_scan_kernel(double a[N], double b[N])
+{
+  linrec_scan_const(N, a, 0.5, 0.5);
+  linrec_scan_const(N, b, 0.5, 0.5);
+}
+
 int main()
 {
   double *a = malloc(N * sizeof(double));
@@ -86,6 +204,64 @@ int main()
   }
   printf("OK results :-)\n");
 
+  // Scan mode: all threads on each array
+  double time_scan;
+
+  for (size_t i = 0; i < N; i++)
+  {
+    ref_a[i] = (float)rand() / (float)(RAND_MAX / MAX_VAL);
+    ref_b[i] = (float)rand() / (float)(RAND_MAX / MAX_VAL);
+    a[i] = ref_a[i];
+    b[i] = ref_b[i];
+  }
+  stencil1D_reference(a, b);
+
+  time_scan = omp_get_wtime();
+  stencil1D_scan_kernel(ref_a, ref_b);
+  time_scan = omp_get_wtime() - time_scan;
+  printf("Scan time ---- : %3.5lf s\n", time_scan);
+  printf("Scan speedup - : %3.5lf\n", time_reference / time_scan);
+
+  for (size_t i = 0; i < N; i++)
+  {
+    if ((ref_a[i] != a[i]) || (ref_b[i] != b[i]))
+    {
+      printf("Bad scan results :-(((\n");
+      exit(1);
+    }
+  }
+  printf("OK scan results :-)\n");
+
+  // Generic scan x[i] = mul[i] * x[i - 1] + add[i] (x: ref_a, mul: b, add:
+  // ref_b) against the sequential loop (a): |mul| < 1 (forgetful), mul = 1
+  for (int pass = 0; pass < 2; pass++)
+  {
+    for (size_t i = 0; i < N; i++)
+    {
+      ref_a[i] = (float)rand() / (float)(RAND_MAX / MAX_VAL);
+      ref_b[i] = (float)rand() / (float)(RAND_MAX / MAX_VAL) - MAX_VAL / 2.;
+      b[i] = (pass == 0) ? (double)rand() / RAND_MAX * 1.8 - 0.9 : 1.;
+    }
+    a[0] = ref_a[0];
+    for (size_t i = 1; i < N; i++)
+      a[i] = b[i] * a[i - 1] + ref_b[i];
+
+    time_scan = omp_get_wtime();
+    linrec_scan(N, ref_a, b, ref_b);
+    time_scan = omp_get_wtime() - time_scan;
+    printf("Scan %s : %3.5lf s\n", (pass == 0) ? "|mul|<1" : "mul = 1", time_scan);
+
+    for (size_t i = 0; i < N; i++)
+    {
+      if (!(fabs(ref_a[i] - a[i]) <= SCAN_ERROR * fmax(fabs(a[i]), 1.)))
+      {
+        printf("Bad generic scan results :-(((\n");
+        exit(1);
+      }
+    }
+  }
+  printf("OK generic scan results :-)\n");
+
   free(a);
   free(b);
   free(ref_a);
@@ -1,9 +1,19 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
 #include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <omp.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#define min(x, y) ((x) < (y) ? (x) : (y))
 #define HYPERTHREADING 1      // 1 if hyperthreading is on, 0 otherwise
 #define ERROR          1.e-20 // Acceptable precision
+#define REL_ERROR      1.e-10 // Acceptable relative precision (reordered sums)
+#define HISTO_BINS     64     // Number of bins of the histograms
 #define MAX_VAL        5      // Random values are [0, MAX_VAL]
 
 // Matrix size (5120: UHD TV)
@@ -30,31 +40,302 @@ void reduction_reinit_reference(double A[N][N], double* sum) {
 
 // Computation kernel 
 void reduction_reinit_kernel(double A[N][N], double* sum) { 
-  *sum = 0.;
-  double somme=0;
-  #pragma omp parallel
-  {
-    #pragma omp for reduction(+:somme)
+  double somme = 0.;
+
+  #pragma omp parallel for reduction(+:somme) schedule(static)
   for (size_t i = 0; i < N; i++) {
     for (size_t j = 0; j < N; j++) {
-      *sum += A[i][j];
+      somme += A[i][j];
       A[i][j] = 0.;
     }
   }
   *sum = somme;
+}
+
+/**
+ * thread_range function:
+ * this function gives the calling thread its part [lo, hi) of an array of
+ * n doubles, bounds being multiples of align elements (a cache line or a
+ * page) so that threads never share a line or a page.
+ */
+static void thread_range(size_t n, size_t align, size_t* lo, size_t* hi) {
+  size_t nb_threads = omp_get_num_threads();
+  size_t tid = omp_get_thread_num();
+  size_t units = (n + align - 1) / align;
+
+  *lo = min(n, units * tid / nb_threads * align);
+  *hi = min(n, units * (tid + 1) / nb_threads * align);
+}
+
+/**
+ * reduction_reinit_stream_kernel function:
+ * same as reduction_reinit on n contiguous elements, in a single pass where
+ * the zeros are written with streaming stores: an ordinary store first
+ * reads the line it writes (read-for-ownership), a streaming store writes
+ * full lines straight to memory, so the pass moves 2 bytes per element of
+ * traffic instead of 3. A must be 16-byte aligned.
+ */
+void reduction_reinit_stream_kernel(size_t n, double* A, double* sum) {
+  double somme = 0.;
+
+  #pragma omp parallel reduction(+:somme)
+  {
+    size_t lo, hi, i;
+    double acc0 = 0., acc1 = 0.;
+    thread_range(n, 8, &lo, &hi);
+    i = lo;
+#ifdef __SSE2__
+    __m128d zero = _mm_setzero_pd();
+    for (; i + 1 < hi; i += 2) {
+      acc0 += A[i];
+      acc1 += A[i + 1];
+      _mm_stream_pd(&A[i], zero);
+    }
+    _mm_sfence();
+#endif
+    for (; i < hi; i++) {
+      acc0 += A[i];
+      A[i] = 0.;
+    }
+    somme += acc0 + acc1;
   }
+  *sum = somme;
+}
+
+/**
+ * reduction_reinit_madvise_kernel function:
+ * same as reduction_reinit on n contiguous elements of an anonymous
+ * private mapping (e.g. a large malloc), for large matrices: instead of
+ * writing zeros, each thread sums its pages then gives them back to the
+ * system with madvise(MADV_DONTNEED). Released pages read as zeros, the
+ * zeroing cost moves to the page faults of the next writes. Only the
+ * elements outside whole pages (the head and the tail, less than a page
+ * each) are written, and the pages of a thread whose madvise fails are
+ * reset with stores.
+ */
+void reduction_reinit_madvise_kernel(size_t n, double* A, double* sum) {
+  size_t page = sysconf(_SC_PAGESIZE) / sizeof(double);
+  size_t head = min((page - ((uintptr_t)A / sizeof(double)) % page) % page, n);
+  double* P = A + head;                   // First whole page
+  size_t np = (n - head) / page * page;   // Elements in whole pages
+  double somme = 0.;
+
+  #pragma omp parallel reduction(+:somme)
+  {
+    size_t lo, hi;
+    thread_range(np, page, &lo, &hi);
+    for (size_t i = lo; i < hi; i++)
+      somme += P[i];
+    if ((hi > lo) && (madvise(P + lo, (hi - lo) * sizeof(double), MADV_DONTNEED) != 0)) {
+      for (size_t i = lo; i < hi; i++)
+        P[i] = 0.;
+    }
+
+    // Head and tail, by the first and the last threads
+    if (omp_get_thread_num() == 0) {
+      for (size_t i = 0; i < head; i++) {
+        somme += A[i];
+        A[i] = 0.;
+      }
+    }
+    if (omp_get_thread_num() == omp_get_num_threads() - 1) {
+      for (size_t i = head + np; i < n; i++) {
+        somme += A[i];
+        A[i] = 0.;
+      }
+    }
+  }
+  *sum = somme;
+}
+
+/**
+ * Multi-statistic reduction:
+ * a stats structure accumulates the statistics selected by its flags over
+ * a set of values: sum, min, max, mean and variance (Welford, merged with
+ * Chan's formula) and a histogram of HISTO_BINS bins over [lo, hi) (values
+ * outside are counted in the first or last bin). It is an OpenMP
+ * reduction type (merge_stats), so each thread privatizes its own copy,
+ * histogram included, and the copies are merged at the end.
+ */
+#define STAT_SUM   1
+#define STAT_MIN   2
+#define STAT_MAX   4
+#define STAT_VAR   8  // Mean and variance
+#define STAT_HISTO 16
+#define STAT_ALL   31
+
+typedef struct {
+  int flags;
+  double lo, hi;          // Histogram range
+  double sum, min, max;
+  double count, mean, m2; // m2: sum of squared deviations from the mean
+  size_t histo[HISTO_BINS];
+} stats;
+
+void stats_init(stats* s, int flags, double lo, double hi) {
+  s->flags = flags;
+  s->lo = lo;
+  s->hi = hi;
+  s->sum = 0.;
+  s->min = INFINITY;
+  s->max = -INFINITY;
+  s->count = 0.;
+  s->mean = 0.;
+  s->m2 = 0.;
+  for (size_t b = 0; b < HISTO_BINS; b++)
+    s->histo[b] = 0;
+}
+
+void stats_merge(stats* out, stats* in) {
+  out->sum += in->sum;
+  out->min = (in->min < out->min) ? in->min : out->min;
+  out->max = (in->max > out->max) ? in->max : out->max;
+  if (in->count > 0.) {
+    double count = out->count + in->count;
+    double delta = in->mean - out->mean;
+    out->mean += delta * in->count / count;
+    out->m2 += in->m2 + delta * delta * out->count * in->count / count;
+    out->count = count;
+  }
+  for (size_t b = 0; b < HISTO_BINS; b++)
+    out->histo[b] += in->histo[b];
+}
+
+double stats_variance(stats* s) {
+  return (s->count > 0.) ? s->m2 / s->count : 0.;
+}
+
+#pragma omp declare reduction(merge_stats : stats : stats_merge(&omp_out, &omp_in)) \
+  initializer(stats_init(&omp_priv, omp_orig.flags, omp_orig.lo, omp_orig.hi))
+
+static inline size_t histo_bin(double x, double lo, double scale) {
+  double b = (x - lo) * scale;
+  if (b < 0.)
+    return 0;
+  return (b < HISTO_BINS - 1) ? (size_t)b : HISTO_BINS - 1;
+}
+
+/**
+ * matrix_stats function:
+ * this function computes the statistics selected in s (initialized by
+ * stats_init) over an n x m matrix in a single parallel pass: each row is
+ * loaded once and all the selected statistics are computed on it while it
+ * is in L1, then merged into the thread copy of s.
+ */
+void matrix_stats(size_t n, size_t m, double A[n][m], stats* s) {
+  stats st = *s;
+  int flags = s->flags;
+  double scale = HISTO_BINS / (s->hi - s->lo);
+
+  #pragma omp parallel for reduction(merge_stats:st) schedule(static)
+  for (size_t i = 0; i < n; i++) {
+    stats row;
+    stats_init(&row, 0, st.lo, st.hi);
+    double sum = 0., mn = INFINITY, mx = -INFINITY, m2 = 0.;
+
+    if (flags & (STAT_SUM | STAT_VAR)) {
+      #pragma omp simd reduction(+:sum)
+      for (size_t j = 0; j < m; j++)
+        sum += A[i][j];
+    }
+    if (flags & STAT_MIN) {
+      #pragma omp simd reduction(min:mn)
+      for (size_t j = 0; j < m; j++)
+        mn = (A[i][j] < mn) ? A[i][j] : mn;
+    }
+    if (flags & STAT_MAX) {
+      #pragma omp simd reduction(max:mx)
+      for (size_t j = 0; j < m; j++)
+        mx = (A[i][j] > mx) ? A[i][j] : mx;
+    }
+    if (flags & STAT_VAR) {
+      double mean = sum / m;
+      #pragma omp simd reduction(+:m2)
+      for (size_t j = 0; j < m; j++)
+        m2 += (A[i][j] - mean) * (A[i][j] - mean);
+      row.count = m;
+      row.mean = mean;
+      row.m2 = m2;
+    }
+    if (flags & STAT_HISTO) {
+      for (size_t j = 0; j < m; j++)
+        row.histo[histo_bin(A[i][j], st.lo, scale)]++;
+    }
+    row.sum = (flags & STAT_SUM) ? sum : 0.;
+    row.min = mn;
+    row.max = mx;
+    stats_merge(&st, &row);
+  }
+  *s = st;
+}
+
+/**
+ * matrix_stats_separate function:
+ * same result as matrix_stats with one parallel pass over the matrix per
+ * statistic (two for the variance), for comparison.
+ */
+void matrix_stats_separate(size_t n, size_t m, double A[n][m], stats* s) {
+  double sum = 0., mn = INFINITY, mx = -INFINITY, m2 = 0.;
+  double scale = HISTO_BINS / (s->hi - s->lo);
+  size_t* histo = s->histo;
+
+  if (s->flags & (STAT_SUM | STAT_VAR)) {
+    #pragma omp parallel for reduction(+:sum) schedule(static)
+    for (size_t i = 0; i < n; i++)
+      for (size_t j = 0; j < m; j++)
+        sum += A[i][j];
+    s->sum = (s->flags & STAT_SUM) ? sum : 0.;
+  }
+  if (s->flags & STAT_MIN) {
+    #pragma omp parallel for reduction(min:mn) schedule(static)
+    for (size_t i = 0; i < n; i++)
+      for (size_t j = 0; j < m; j++)
+        mn = (A[i][j] < mn) ? A[i][j] : mn;
+    s->min = mn;
+  }
+  if (s->flags & STAT_MAX) {
+    #pragma omp parallel for reduction(max:mx) schedule(static)
+    for (size_t i = 0; i < n; i++)
+      for (size_t j = 0; j < m; j++)
+        mx = (A[i][j] > mx) ? A[i][j] : mx;
+    s->max = mx;
+  }
+  if (s->flags & STAT_VAR) {
+    double mean = sum / ((double)n * m);
+    #pragma omp parallel for reduction(+:m2) schedule(static)
+    for (size_t i = 0; i < n; i++)
+      for (size_t j = 0; j < m; j++)
+        m2 += (A[i][j] - mean) * (A[i][j] - mean);
+    s->count = (double)n * m;
+    s->mean = mean;
+    s->m2 = m2;
+  }
+  if (s->flags & STAT_HISTO) {
+    #pragma omp parallel for reduction(+:histo[:HISTO_BINS]) schedule(static)
+    for (size_t i = 0; i < n; i++)
+      for (size_t j = 0; j < m; j++)
+        histo[histo_bin(A[i][j], s->lo, scale)]++;
+  }
+}
+
+// Writes the matrix (next iteration): pays the page faults after madvise
+void refill(size_t n, double* A) {
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; i++)
+    A[i] = 1.;
 }
 
 int main() {
   double* AR = malloc(N * N * sizeof(double));
   double* AK = malloc(N * N * sizeof(double));
+  double* AI = malloc(N * N * sizeof(double));
   double sum_ref, sum_ker;
   double time_reference, time_kernel, speedup, efficiency;
 
   // Initialization by random values
   srand((unsigned int)time(NULL));
   for (size_t i = 0; i < N * N; i++)
-    AR[i] = AK[i] = (float)rand()/(float)(RAND_MAX/MAX_VAL);
+    AI[i] = AR[i] = AK[i] = (float)rand()/(float)(RAND_MAX/MAX_VAL);
 
   time_reference = omp_get_wtime();
   reduction_reinit_reference((double (*)[N])AR, &sum_ref);
@@ -72,7 +353,7 @@ int main() {
   printf("Efficiency --- : %3.5lf\n", efficiency);
 
   // Check if the result differs from the reference
-  if (abs(sum_ref - sum_ker) > ERROR) {
+  if (fabs(sum_ref - sum_ker) > REL_ERROR * fabs(sum_ref)) {
     printf("Bad results :-(((\n");
     exit(1);
   }
@@ -86,6 +367,78 @@ int main() {
   }
   printf("OK results :-)\n");
 
+  // Fused single pass modes: streaming zero stores, page release
+  const char* names[2] = {"Stream", "Madvise"};
+  for (int mode = 0; mode < 2; mode++) {
+    double time_mode, time_refill;
+
+    for (size_t i = 0; i < N * N; i++)
+      AK[i] = AI[i];
+
+    time_mode = omp_get_wtime();
+    if (mode == 0)
+      reduction_reinit_stream_kernel(N * N, AK, &sum_ker);
+    else
+      reduction_reinit_madvise_kernel(N * N, AK, &sum_ker);
+    time_mode = omp_get_wtime() - time_mode;
+
+    if (fabs(sum_ref - sum_ker) > REL_ERROR * fabs(sum_ref)) {
+      printf("Bad %s results :-(((\n", names[mode]);
+      exit(1);
+    }
+    for (size_t i = 0; i < N * N; i++) {
+      if (AK[i] != 0.) {
+        printf("Bad %s results :-(((\n", names[mode]);
+        exit(1);
+      }
+    }
+
+    time_refill = omp_get_wtime();
+    refill(N * N, AK);
+    time_refill = omp_get_wtime() - time_refill;
+    printf("%-7s time - : %3.5lf s (speedup %3.5lf, next refill %3.5lf s)\n",
+           names[mode], time_mode, time_reference / time_mode, time_refill);
+  }
+  printf("OK fused results :-)\n");
+
+  // Multi-statistic reduction: one fused pass vs one pass per statistic
+  stats st_fused, st_separate;
+  double time_fused, time_separate;
+
+  stats_init(&st_fused, STAT_ALL, 0., MAX_VAL);
+  time_fused = omp_get_wtime();
+  matrix_stats(N, N, (double (*)[N])AI, &st_fused);
+  time_fused = omp_get_wtime() - time_fused;
+
+  stats_init(&st_separate, STAT_ALL, 0., MAX_VAL);
+  time_separate = omp_get_wtime();
+  matrix_stats_separate(N, N, (double (*)[N])AI, &st_separate);
+  time_separate = omp_get_wtime() - time_separate;
+
+  printf("Stats fused -- : %3.5lf s\n", time_fused);
+  printf("Stats separate : %3.5lf s (fusion speedup %3.5lf)\n",
+         time_separate, time_separate / time_fused);
+  printf("Sum %.6lf, min %g, max %g, mean %.9lf, variance %.9lf\n",
+         st_fused.sum, st_fused.min, st_fused.max, st_fused.mean,
+         stats_variance(&st_fused));
+
+  if ((fabs(st_fused.sum - sum_ref) > REL_ERROR * fabs(sum_ref)) ||
+      (st_fused.min != st_separate.min) || (st_fused.max != st_separate.max) ||
+      (fabs(st_fused.mean - st_separate.mean) > REL_ERROR * fabs(st_separate.mean)) ||
+      (fabs(stats_variance(&st_fused) - stats_variance(&st_separate)) >
+       REL_ERROR * stats_variance(&st_separate))) {
+    printf("Bad stats results :-(((\n");
+    exit(1);
+  }
+  for (size_t b = 0; b < HISTO_BINS; b++) {
+    if (st_fused.histo[b] != st_separate.histo[b]) {
+      printf("Bad histogram results :-(((\n");
+      exit(1);
+    }
+  }
+  printf("OK stats results :-)\n");
+
+  free(AI);
   free(AK);
   free(AR);
   return 0;
@@ -1,5 +1,8 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
 #include <time.h>
 #include <omp.h>
 #define max(x, y) ((x) > (y) ? (x) : (y))
@@ -7,6 +10,35 @@
 #define HYPERTHREADING 1 // 1 if hyperthreading is on, 0 otherwise
 #define ERROR 1.e-20     // Acceptable precision
 #define MAX_VAL 5        // Random values are [0, MAX_VAL]
+#define FFT_ERROR 1.e-12 // Acceptable normwise relative error of the FFT path
+#define KARATSUBA_ERROR 1.e-9 // Same for Karatsuba (subtractions cancel digits)
+
+// FFT multiplication parameters
+// Smallest length using the FFT. The crossover is machine-specific (512 to
+// 1024 on recent x86 cores): run "tune" and rebuild with
+// -DPOLY_FFT_THRESHOLD=<length>
+#ifndef POLY_FFT_THRESHOLD
+#define POLY_FFT_THRESHOLD 1024
+#endif
+#define FFT_PARALLEL_MIN 4096   // Smallest FFT size using several threads
+#define POLY_ERROR_SIZES 5      // Sizes of the error table above the threshold (N, 2N...)
+
+// Direct and Karatsuba multiplication parameters
+#define CONV_BLOCK_K 64       // Output coefficients per register block
+#define CONV_BLOCK_I 1024     // Input coefficients per cache block
+#define KARATSUBA_CUTOFF 64   // Largest length multiplied directly
+#define KARATSUBA_TASK_MIN 8192 // Smallest length spawning tasks
+#define BENCH_MAX 1024000     // Largest length of the "bench" mode
+#define BENCH_REF_MAX 32000   // Largest length timed with the reference
+#define BENCH_DIRECT_MAX 128000 // Largest length timed with the direct kernel
+
+// Multipoint evaluation parameters
+#define EVAL_LANES 32         // Points per register block (independent chains)
+#define EVAL_BLOCK 1024       // Points per cache block (shared by the batch)
+#define EVAL_ERROR 1.e-12     // Acceptable normwise relative error
+#define EVAL_POINTS 20000000  // Default number of points of the "eval" mode
+#define EVAL_DEGREE 16        // Default degree of the "eval" mode
+#define EVAL_BATCH 8          // Number of polynomials of the "eval" mode
 
 // Matrix and vector sizes (5120: UHD TV)
 #define N 5000
@@ -34,24 +66,735 @@ void polynomial_multiply_reference(double c[2 * N - 1], double a[N], double b[N]
     }
 }
 
+/**
+ * convolution_range function:
+ * this function computes the coefficients [k0, k1) of c = a * b (they are
+ * overwritten) as a diagonal convolution c[k] = sum a[i] * b[k - i].
+ * Outputs are processed by CONV_BLOCK_K (SIMD lanes over k, accumulators
+ * in registers), inputs by CONV_BLOCK_I so that the slices of a and b in
+ * use stay in L1. Each c[k] sums its terms in increasing i, as the
+ * reference does, so the results are identical.
+ */
+static void convolution_range(double *c, size_t k0, size_t k1,
+                              size_t na, double *a, size_t nb, double *b)
+{
+  for (size_t k = k0; k < k1; k++)
+    c[k] = 0.;
+
+  for (size_t i0 = 0; i0 < na; i0 += CONV_BLOCK_I)
+  {
+    size_t i1 = min(i0 + CONV_BLOCK_I, na);
+    for (size_t kb = k0; kb < k1; kb += CONV_BLOCK_K)
+    {
+      size_t ke = min(kb + CONV_BLOCK_K, k1);
+      // Terms of the block: i <= k and k - i < nb
+      size_t ilo = max(i0, (kb + 1 > nb) ? kb + 1 - nb : 0);
+      size_t ihi = min(i1, ke);
+      double acc[CONV_BLOCK_K];
+
+      if (ilo >= ihi)
+        continue;
+      for (size_t k = kb; k < ke; k++)
+        acc[k - kb] = c[k];
+      for (size_t i = ilo; i < ihi; i++)
+      {
+        size_t lo = max(kb, i), hi = min(ke, i + nb);
+        double ai = a[i];
+        double *bi = b - i;
+        if ((lo == kb) && (hi == kb + CONV_BLOCK_K))
+        {
+          #pragma omp simd
+          for (size_t k = 0; k < CONV_BLOCK_K; k++)
+            acc[k] += ai * bi[kb + k];
+        }
+        else
+        {
+          for (size_t k = lo; k < hi; k++)
+            acc[k - kb] += ai * bi[k];
+        }
+      }
+      for (size_t k = kb; k < ke; k++)
+        c[k] = acc[k - kb];
+    }
+  }
+}
+
+/**
+ * polynomial_multiply_partitioned function:
+ * this function computes c = a * b (c is overwritten) in parallel without
+ * any race: each thread owns a contiguous range of output coefficients
+ * and computes it with convolution_range. Ranges are cut so that every
+ * thread gets about the same number of terms (outputs near the middle of
+ * c have more terms than outputs at the ends).
+ */
+void polynomial_multiply_partitioned(double *c, size_t na, double *a, size_t nb, double *b)
+{
+  size_t nc = na + nb - 1;
+
+  #pragma omp parallel
+  {
+    size_t nb_threads = omp_get_num_threads();
+    size_t tid = omp_get_thread_num();
+    size_t total = na * nb;
+    size_t begin = total / nb_threads * tid + total % nb_threads * tid / nb_threads;
+    size_t end = total / nb_threads * (tid + 1) + total % nb_threads * (tid + 1) / nb_threads;
+    size_t k0 = nc, k1 = nc, work = 0;
+
+    // Terms of c[k]: min(k, na - 1) - max(0, k - nb + 1) + 1
+    for (size_t k = 0; k < nc; k++)
+    {
+      if ((k0 == nc) && (work >= begin))
+        k0 = k;
+      if (work >= end)
+      {
+        k1 = k;
+        break;
+      }
+      work += min(k, na - 1) + 1 - ((k + 1 > nb) ? k + 1 - nb : 0);
+    }
+    if (tid == nb_threads - 1)
+      k1 = nc;
+    convolution_range(c, k0, max(k0, k1), na, a, nb, b);
+  }
+}
+
 // Computation kernel 
 void polynomial_multiply_kernel(double c[2 * N - 1], double a[N], double b[N])
 {
-  size_t j, i = 0;
-#pragma omp parallel private(i,j) shared(c)
+  polynomial_multiply_partitioned(c, N, a, N, b);
+}
+
+/**
+ * FFT:
+ * in-place complex FFT of size n (a power of 2): bit reversal permutation,
+ * then radix-4 passes, each one doing the work of two radix-2 stages in a
+ * single sweep over the data, plus a radix-2 pass first when log2(n) is
+ * odd. Passes are parallelized over their n / 4 (or n / 2) butterflies.
+ * sign is -1 for the forward transform, +1 for the inverse one (not
+ * scaled by 1 / n). w must hold the n / 2 twiddles exp(sign 2 i pi k / n).
+ */
+static void fft_twiddles(size_t n, double complex w[n / 2], int sign)
+{
+  #pragma omp parallel for schedule(static) if (n >= FFT_PARALLEL_MIN)
+  for (size_t k = 0; k < n / 2; k++)
+    w[k] = cexp(sign * 2. * M_PI * I * (double)k / (double)n);
+}
+
+static void fft(size_t n, double complex x[n], double complex w[n / 2], int sign)
+{
+  size_t log_n = 0;
+  while (((size_t)1 << log_n) < n)
+    log_n++;
+
+  #pragma omp parallel if (n >= FFT_PARALLEL_MIN)
+  {
+    #pragma omp for schedule(static)
+    for (size_t i = 0; i < n; i++)
+    {
+      size_t r = 0;
+      for (size_t b = 0; b < log_n; b++)
+        r |= ((i >> b) & 1) << (log_n - 1 - b);
+      if (i < r)
+      {
+        double complex t = x[i];
+        x[i] = x[r];
+        x[r] = t;
+      }
+    }
+
+    size_t q = 1; // Half span of the next radix-2 stage
+    if (log_n % 2 == 1)
+    {
+      #pragma omp for schedule(static)
+      for (size_t i = 0; i < n; i += 2)
+      {
+        double complex t = x[i + 1];
+        x[i + 1] = x[i] - t;
+        x[i] = x[i] + t;
+      }
+      q = 2;
+    }
+
+    // Radix-4 pass: stages of half span q and 2q on blocks of 4q
+    double complex rot = (sign < 0) ? -I : I; // exp(sign i pi / 2)
+    for (; q < n; q *= 4)
+    {
+      size_t stride = n / (4 * q);
+      #pragma omp for schedule(static)
+      for (size_t t = 0; t < n / 4; t++)
+      {
+        size_t j = t % q;
+        size_t base = (t / q) * 4 * q + j;
+        double complex w1 = w[j * stride];    // exp(sign 2 i pi j / 4q)
+        double complex w2 = w[2 * j * stride]; // exp(sign 2 i pi j / 2q)
+        double complex a0 = x[base];
+        double complex a1 = x[base + q] * w2;
+        double complex a2 = x[base + 2 * q];
+        double complex a3 = x[base + 3 * q] * w2;
+        double complex b0 = a0 + a1, b1 = a0 - a1;
+        double complex b2 = (a2 + a3) * w1, b3 = (a2 - a3) * w1 * rot;
+        x[base] = b0 + b2;
+        x[base + q] = b1 + b3;
+        x[base + 2 * q] = b0 - b2;
+        x[base + 3 * q] = b1 - b3;
+      }
+    }
+  }
+}
+
+/**
+ * polynomial_multiply_direct function:
+ * this function computes c = a * b (na + nb - 1 coefficients, c is
+ * overwritten) with the schoolbook algorithm, for runtime lengths.
+ */
+void polynomial_multiply_direct(double *c, size_t na, double *a, size_t nb, double *b)
+{
+  if ((na == 0) || (nb == 0))
+    return;
+  for (size_t k = 0; k < na + nb - 1; k++)
+    c[k] = 0.;
+  for (size_t i = 0; i < na; i++)
+    for (size_t j = 0; j < nb; j++)
+      c[i + j] += a[i] * b[j];
+}
+
+/**
+ * Karatsuba:
+ * for polynomials of length n split as a = a0 + x^m a1 (m = n / 2),
+ * a * b = z0 + x^m (z1 - z0 - z2) + x^2m z2 with z0 = a0 * b0,
+ * z2 = a1 * b1 and z1 = (a0 + a1) * (b0 + b1): 3 products of half length
+ * instead of 4, O(n^1.58) operations. z0 and z2 are computed in place in
+ * c, the other temporaries in a scratch buffer given by the caller
+ * (karatsuba_scratch elements) and reused by the sequential recursion.
+ * Above KARATSUBA_TASK_MIN the three products are OpenMP tasks, each with
+ * its own temporaries. Lengths below KARATSUBA_CUTOFF are multiplied with
+ * convolution_range.
+ */
+static size_t karatsuba_scratch(size_t n)
+{
+  if (n <= KARATSUBA_CUTOFF)
+    return 0;
+  size_t h = n - n / 2;
+  return 4 * h - 1 + karatsuba_scratch(h);
+}
+
+// c (2n - 1 coefficients) += x^m * (z1 - z0 - z2), h = n - m
+static void karatsuba_combine(double *c, size_t n, size_t m, double *z1)
+{
+  size_t h = n - m;
+  double *z0 = c, *z2 = c + 2 * m;
+
+  for (size_t k = 0; k < 2 * h - 1; k++)
+  {
+    double t = z1[k];
+    if (k < 2 * m - 1)
+      t -= z0[k];
+    t -= z2[k];
+    z1[k] = t;
+  }
+  c[2 * m - 1] = 0.;
+  for (size_t k = 0; k < 2 * h - 1; k++)
+    c[m + k] += z1[k];
+}
+
+static void karatsuba_sequential(double *c, size_t n, double *a, double *b, double *scratch)
+{
+  if (n <= KARATSUBA_CUTOFF)
+  {
+    convolution_range(c, 0, 2 * n - 1, n, a, n, b);
+    return;
+  }
+  size_t m = n / 2, h = n - m;
+  double *sa = scratch, *sb = scratch + h, *z1 = scratch + 2 * h;
+  double *next = z1 + 2 * h - 1;
+
+  for (size_t i = 0; i < h; i++)
+  {
+    sa[i] = a[m + i] + ((i < m) ? a[i] : 0.);
+    sb[i] = b[m + i] + ((i < m) ? b[i] : 0.);
+  }
+  karatsuba_sequential(z1, h, sa, sb, next);
+  karatsuba_sequential(c, m, a, b, next);
+  karatsuba_sequential(c + 2 * m, h, a + m, b + m, next);
+  karatsuba_combine(c, n, m, z1);
+}
+
+static void karatsuba_tasks(double *c, size_t n, double *a, double *b)
+{
+  if (n < KARATSUBA_TASK_MIN)
+  {
+    double *scratch = malloc(max(karatsuba_scratch(n), 1) * sizeof(double));
+    karatsuba_sequential(c, n, a, b, scratch);
+    free(scratch);
+    return;
+  }
+  size_t m = n / 2, h = n - m;
+  double *sa = malloc(h * sizeof(double));
+  double *sb = malloc(h * sizeof(double));
+  double *z1 = malloc((2 * h - 1) * sizeof(double));
+
+  for (size_t i = 0; i < h; i++)
+  {
+    sa[i] = a[m + i] + ((i < m) ? a[i] : 0.);
+    sb[i] = b[m + i] + ((i < m) ? b[i] : 0.);
+  }
+  #pragma omp task
+  karatsuba_tasks(z1, h, sa, sb);
+  #pragma omp task
+  karatsuba_tasks(c, m, a, b);
+  #pragma omp task
+  karatsuba_tasks(c + 2 * m, h, a + m, b + m);
+  #pragma omp taskwait
+  karatsuba_combine(c, n, m, z1);
+
+  free(sa);
+  free(sb);
+  free(z1);
+}
+
+/**
+ * polynomial_multiply_karatsuba function:
+ * this function computes c = a * b (c is overwritten) with Karatsuba.
+ * When the lengths differ, the longest polynomial is cut in pieces of the
+ * length of the shortest one (the last piece is padded with zeros) whose
+ * products are added at their offsets.
+ */
+void polynomial_multiply_karatsuba(double *c, size_t na, double *a, size_t nb, double *b)
+{
+  if (na < nb)
+  {
+    polynomial_multiply_karatsuba(c, nb, b, na, a);
+    return;
+  }
+  size_t nc = na + nb - 1;
+  double *piece = malloc(nb * sizeof(double));
+  double *prod = malloc((2 * nb - 1) * sizeof(double));
+
+  for (size_t k = 0; k < nc; k++)
+    c[k] = 0.;
+  for (size_t p = 0; p < na; p += nb)
+  {
+    size_t len = min(nb, na - p);
+    for (size_t i = 0; i < nb; i++)
+      piece[i] = (i < len) ? a[p + i] : 0.;
+
+    #pragma omp parallel
+    #pragma omp single
+    karatsuba_tasks(prod, nb, piece, b);
+
+    for (size_t k = 0; k < len + nb - 1; k++)
+      c[p + k] += prod[k];
+  }
+  free(piece);
+  free(prod);
+}
+
+/**
+ * polynomial_multiply_fft function:
+ * this function computes c = a * b (c is overwritten) as a cyclic
+ * convolution of size n >= na + nb - 1: both real polynomials are packed
+ * in one complex signal z = a + i b, so that a single forward FFT gives
+ * A(k) B(k) = (Z(k)^2 - conj(Z(n - k))^2) / 4i, then one inverse FFT.
+ * The error is about eps log(n) max|a| max|b| min(na, nb) on every
+ * coefficient, i.e. normwise rather than coefficient-wise.
+ */
+void polynomial_multiply_fft(double *c, size_t na, double *a, size_t nb, double *b)
+{
+  size_t nc = na + nb - 1;
+  size_t n = 1;
+  while (n < nc)
+    n *= 2;
+
+  double complex *z = malloc(n * sizeof(double complex));
+  double complex *p = malloc(n * sizeof(double complex));
+  double complex *w = malloc(max(n / 2, 1) * sizeof(double complex));
+
+  #pragma omp parallel for schedule(static) if (n >= FFT_PARALLEL_MIN)
+  for (size_t k = 0; k < n; k++)
+    z[k] = ((k < na) ? a[k] : 0.) + I * ((k < nb) ? b[k] : 0.);
+
+  fft_twiddles(n, w, -1);
+  fft(n, z, w, -1);
+
+  #pragma omp parallel for schedule(static) if (n >= FFT_PARALLEL_MIN)
+  for (size_t k = 0; k < n; k++)
+  {
+    double complex zk = z[k];
+    double complex zm = conj(z[(n - k) % n]);
+    p[k] = (zk * zk - zm * zm) / (4. * I);
+  }
+
+  // Inverse twiddles are the conjugates of the forward ones
+  #pragma omp parallel for schedule(static) if (n >= FFT_PARALLEL_MIN)
+  for (size_t k = 0; k < n / 2; k++)
+    w[k] = conj(w[k]);
+  fft(n, p, w, 1);
+
+  #pragma omp parallel for schedule(static) if (n >= FFT_PARALLEL_MIN)
+  for (size_t k = 0; k < nc; k++)
+    c[k] = creal(p[k]) / n;
+
+  free(z);
+  free(p);
+  free(w);
+}
+
+/**
+ * polynomial_multiply_auto function:
+ * this function computes c = a * b (c is overwritten) with the FFT when
+ * the shortest polynomial has at least POLY_FFT_THRESHOLD coefficients
+ * (the O(n log n) path wins), with the parallel direct kernel otherwise.
+ */
+void polynomial_multiply_auto(double *c, size_t na, double *a, size_t nb, double *b)
+{
+  if (min(na, nb) >= POLY_FFT_THRESHOLD)
+    polynomial_multiply_fft(c, na, a, nb, b);
+  else
+    polynomial_multiply_partitioned(c, na, a, nb, b);
+}
+
+// Returns max|c - ref| / max|ref| over n coefficients
+double normwise_error(size_t n, double *ref, double *c)
+{
+  double error = 0., norm = 0.;
+
+  for (size_t i = 0; i < n; i++)
+  {
+    error = max(error, fabs(ref[i] - c[i]));
+    norm = max(norm, fabs(ref[i]));
+  }
+  return (norm > 0.) ? error / norm : error;
+}
+
+/**
+ * tune function:
+ * this function times the direct and FFT paths for lengths growing by
+ * powers of 2 and prints the first length where the FFT is faster, the
+ * value to use for POLY_FFT_THRESHOLD on this machine.
+ */
+void tune(void)
+{
+  size_t crossover = 0;
+
+  printf("%10s %14s %14s\n", "Length", "Direct (s)", "FFT (s)");
+  for (size_t n = 8; n <= 8192; n *= 2)
+  {
+    double *a = malloc(n * sizeof(double));
+    double *c = malloc(2 * n * sizeof(double));
+    double time_direct, time_fft;
+    size_t repeat = max(1, (1 << 22) / (n * n));
+
+    for (size_t i = 0; i < n; i++)
+      a[i] = (float)rand() / (float)(RAND_MAX / MAX_VAL);
+
+    time_direct = omp_get_wtime();
+    for (size_t r = 0; r < repeat; r++)
+      polynomial_multiply_partitioned(c, n, a, n, a);
+    time_direct = (omp_get_wtime() - time_direct) / repeat;
+
+    time_fft = omp_get_wtime();
+    for (size_t r = 0; r < repeat; r++)
+      polynomial_multiply_fft(c, n, a, n, a);
+    time_fft = (omp_get_wtime() - time_fft) / repeat;
+
+    printf("%10zu %14.3le %14.3le\n", n, time_direct, time_fft);
+    if ((crossover == 0) && (time_fft < time_direct))
+      crossover = n;
+    free(a);
+    free(c);
+  }
+  printf("FFT faster from length %zu (POLY_FFT_THRESHOLD is %d)\n",
+         crossover, POLY_FFT_THRESHOLD);
+}
+
+/**
+ * Multipoint evaluation:
+ * polynomials use the layout of polynomial_multiply (p[i] is the
+ * coefficient of x^i, n coefficients). Horner's rule p(x) = p[0] + x (p[1]
+ * + x (...)) is the most accurate but is a chain of n dependent FMAs,
+ * Estrin's scheme pairs coefficients with x, then pairs of pairs with x^2,
+ * x^4..., log2(n) levels of independent operations (more instruction level
+ * parallelism, slightly larger error).
+ */
+typedef enum
+{
+  EVAL_HORNER,
+  EVAL_ESTRIN
+} eval_method;
+
+// Reference: scalar Horner, one point at a time
+void polynomial_eval_reference(size_t n, double *p, size_t m, double *x, double *y)
+{
+  for (size_t j = 0; j < m; j++)
+  {
+    double acc = p[n - 1];
+    for (size_t i = n - 1; i-- > 0;)
+      acc = acc * x[j] + p[i];
+    y[j] = acc;
+  }
+}
+
+// Horner on EVAL_LANES points (vectorized over the points)
+static inline void eval_horner_lanes(size_t n, double *p, double *x, double *y)
+{
+  double acc[EVAL_LANES];
+
+  #pragma omp simd
+  for (size_t l = 0; l < EVAL_LANES; l++)
+    acc[l] = p[n - 1];
+  for (size_t i = n - 1; i-- > 0;)
+  {
+    #pragma omp simd
+    for (size_t l = 0; l < EVAL_LANES; l++)
+      acc[l] = acc[l] * x[l] + p[i];
+  }
+  for (size_t l = 0; l < EVAL_LANES; l++)
+    y[l] = acc[l];
+}
+
+// Estrin on EVAL_LANES points, t holds (n + 1) / 2 * EVAL_LANES doubles
+static inline void eval_estrin_lanes(size_t n, double *p, double *x, double *y, double *t)
+{
+  double pw[EVAL_LANES];
+  size_t count = (n + 1) / 2;
+
+  for (size_t i = 0; i < count; i++)
+  {
+    double lo = p[2 * i], hi = (2 * i + 1 < n) ? p[2 * i + 1] : 0.;
+    #pragma omp simd
+    for (size_t l = 0; l < EVAL_LANES; l++)
+      t[i * EVAL_LANES + l] = lo + hi * x[l];
+  }
+  #pragma omp simd
+  for (size_t l = 0; l < EVAL_LANES; l++)
+    pw[l] = x[l] * x[l];
+  while (count > 1)
+  {
+    size_t half = count / 2;
+    for (size_t i = 0; i < half; i++)
+    {
+      #pragma omp simd
+      for (size_t l = 0; l < EVAL_LANES; l++)
+        t[i * EVAL_LANES + l] = t[2 * i * EVAL_LANES + l] +
+                                t[(2 * i + 1) * EVAL_LANES + l] * pw[l];
+    }
+    if (count % 2 == 1)
+    {
+      #pragma omp simd
+      for (size_t l = 0; l < EVAL_LANES; l++)
+        t[half * EVAL_LANES + l] = t[(count - 1) * EVAL_LANES + l];
+    }
+    count = half + count % 2;
+    #pragma omp simd
+    for (size_t l = 0; l < EVAL_LANES; l++)
+      pw[l] = pw[l] * pw[l];
+  }
+  for (size_t l = 0; l < EVAL_LANES; l++)
+    y[l] = t[l];
+}
+
+/**
+ * polynomial_eval_batch function:
+ * this function evaluates nb_poly polynomials of n coefficients
+ * (P[q * n + i]) at the m points x, Y[q * m + j] = P_q(x[j]), in a single
+ * parallel pass over the points: threads take blocks of EVAL_BLOCK points,
+ * which stay in L1 while every polynomial of the batch is evaluated on
+ * them, EVAL_LANES points at a time.
+ */
+void polynomial_eval_batch(eval_method method, size_t nb_poly, size_t n, double *P,
+                           size_t m, double *x, double *Y)
+{
+  size_t nb_blocks = (m + EVAL_BLOCK - 1) / EVAL_BLOCK;
+
+  #pragma omp parallel
+  {
+    double *t = malloc((n + 1) / 2 * EVAL_LANES * sizeof(double));
+    double xl[EVAL_LANES], yl[EVAL_LANES];
+
+    #pragma omp for schedule(static)
+    for (size_t blk = 0; blk < nb_blocks; blk++)
+    {
+      size_t j1 = min((blk + 1) * EVAL_BLOCK, m);
+      for (size_t q = 0; q < nb_poly; q++)
+      {
+        for (size_t j = blk * EVAL_BLOCK; j < j1; j += EVAL_LANES)
+        {
+          size_t lanes = min(EVAL_LANES, j1 - j);
+          double *xs = x + j, *ys = Y + q * m + j;
+
+          if (lanes < EVAL_LANES) // Last partial group: padded copy
+          {
+            for (size_t l = 0; l < EVAL_LANES; l++)
+              xl[l] = (l < lanes) ? x[j + l] : 0.;
+            xs = xl;
+            ys = yl;
+          }
+          if (method == EVAL_HORNER)
+            eval_horner_lanes(n, P + q * n, xs, ys);
+          else
+            eval_estrin_lanes(n, P + q * n, xs, ys, t);
+          if (lanes < EVAL_LANES)
+            for (size_t l = 0; l < lanes; l++)
+              Y[q * m + j + l] = yl[l];
+        }
+      }
+    }
+    free(t);
+  }
+}
+
+/**
+ * eval function:
+ * this function evaluates a batch of EVAL_BATCH random polynomials of the
+ * given degree at m random points of [-1, 1] with the reference, Horner
+ * and Estrin, and prints times, throughput and normwise errors.
+ */
+void eval(size_t m, size_t degree)
+{
+  size_t n = degree + 1;
+  double *P = malloc(EVAL_BATCH * n * sizeof(double));
+  double *x = malloc(m * sizeof(double));
+  double *ref = malloc(EVAL_BATCH * m * sizeof(double));
+  double *Y = malloc(EVAL_BATCH * m * sizeof(double));
+  const char *names[2] = {"Horner", "Estrin"};
+  double time_reference, time_batch;
+
+  for (size_t i = 0; i < EVAL_BATCH * n; i++)
+    P[i] = (float)rand() / (float)(RAND_MAX / MAX_VAL);
+  for (size_t j = 0; j < m; j++)
+    x[j] = 2. * rand() / RAND_MAX - 1.;
+  memset(Y, 0, EVAL_BATCH * m * sizeof(double)); // Page faults out of the timings
+
+  printf("%d polynomials of degree %zu, %zu points\n", EVAL_BATCH, degree, m);
+  time_reference = omp_get_wtime();
+  for (size_t q = 0; q < EVAL_BATCH; q++)
+    polynomial_eval_reference(n, P + q * n, m, x, ref + q * m);
+  time_reference = omp_get_wtime() - time_reference;
+  printf("Reference time : %3.5lf s (%.1lf Mevals/s)\n", time_reference,
+         EVAL_BATCH * m / time_reference * 1.e-6);
+
+  for (int method = EVAL_HORNER; method <= EVAL_ESTRIN; method++)
+  {
+    time_batch = omp_get_wtime();
+    polynomial_eval_batch(method, EVAL_BATCH, n, P, m, x, Y);
+    time_batch = omp_get_wtime() - time_batch;
+
+    double error = normwise_error(EVAL_BATCH * m, ref, Y);
+    printf("%s time -- : %3.5lf s (%.1lf Mevals/s, speedup %3.5lf, error %.2le)\n",
+           names[method], time_batch, EVAL_BATCH * m / time_batch * 1.e-6,
+           time_reference / time_batch, error);
+    if (error > EVAL_ERROR)
+    {
+      printf("Bad %s results :-(((\n", names[method]);
+      exit(1);
+    }
+  }
+  printf("OK evaluation results :-)\n");
+
+  free(P);
+  free(x);
+  free(ref);
+  free(Y);
+}
+
+/**
+ * bench function:
+ * this function times the reference, the partitioned direct kernel,
+ * Karatsuba and the FFT for lengths from 1000 to max_length (doubling).
+ * The reference and the direct kernel are only run up to BENCH_REF_MAX
+ * and BENCH_DIRECT_MAX. Errors are normwise, against the reference, or
+ * the direct kernel when the reference is not run.
+ */
+void bench(size_t max_length)
+{
+  printf("%9s %11s %11s %11s %11s %10s %10s\n", "Length", "Ref (s)", "Direct (s)",
+         "Karat. (s)", "FFT (s)", "Err Kar.", "Err FFT");
+  for (size_t n = 1000; n <= max_length; n *= 2)
   {
-#pragma omp for 
-    for (i = 0; i < N; i++)
-      for (j = 0; j < N; j++)
+    double *x = malloc(n * sizeof(double));
+    double *y = malloc(n * sizeof(double));
+    double *r = calloc(2 * n - 1, sizeof(double));
+    double *z = malloc((2 * n - 1) * sizeof(double));
+    double time_ref = NAN, time_direct = NAN, time_kara, time_fft;
+    double error_kara = NAN, error_fft = NAN;
+    int has_ref = (n <= BENCH_DIRECT_MAX);
+
+    for (size_t i = 0; i < n; i++)
+    {
+      x[i] = (float)rand() / (float)(RAND_MAX / MAX_VAL);
+      y[i] = (float)rand() / (float)(RAND_MAX / MAX_VAL);
+    }
+    if (n <= BENCH_REF_MAX)
+    {
+      time_ref = omp_get_wtime();
+      polynomial_multiply_direct(r, n, x, n, y);
+      time_ref = omp_get_wtime() - time_ref;
+    }
+    if (n <= BENCH_DIRECT_MAX)
+    {
+      time_direct = omp_get_wtime();
+      polynomial_multiply_partitioned(z, n, x, n, y);
+      time_direct = omp_get_wtime() - time_direct;
+      if ((n <= BENCH_REF_MAX) && (normwise_error(2 * n - 1, r, z) != 0.))
       {
-        c[i + j] += a[i] * b[j];
-        //printf("c[%ld]= %f \n",i+j,c[i+j]);
+        printf("Bad direct results :-(((\n");
+        exit(1);
       }
+      memcpy(r, z, (2 * n - 1) * sizeof(double));
+    }
+
+    time_kara = omp_get_wtime();
+    polynomial_multiply_karatsuba(z, n, x, n, y);
+    time_kara = omp_get_wtime() - time_kara;
+    if (has_ref)
+      error_kara = normwise_error(2 * n - 1, r, z);
+
+    time_fft = omp_get_wtime();
+    polynomial_multiply_fft(z, n, x, n, y);
+    time_fft = omp_get_wtime() - time_fft;
+    if (has_ref)
+      error_fft = normwise_error(2 * n - 1, r, z);
+
+    printf("%9zu %11.5lf %11.5lf %11.5lf %11.5lf %10.2le %10.2le\n", n, time_ref,
+           time_direct, time_kara, time_fft, error_kara, error_fft);
+    if ((error_kara > KARATSUBA_ERROR) || (error_fft > FFT_ERROR))
+    {
+      printf("Bad results :-(((\n");
+      exit(1);
+    }
+    free(x);
+    free(y);
+    free(r);
+    free(z);
   }
 }
 
-int main()
+int main(int argc, char *argv[])
 {
+  // Evaluation mode: tp1_8_polynomial eval [points] [degree]
+  if (argc > 1 && strcmp(argv[1], "eval") == 0)
+  {
+    srand((unsigned int)time(NULL));
+    eval((argc > 2) ? (size_t)atol(argv[2]) : EVAL_POINTS,
+         (argc > 3) ? (size_t)atol(argv[3]) : EVAL_DEGREE);
+    return 0;
+  }
+
+  // Benchmark mode: tp1_8_polynomial bench [max length]
+  if (argc > 1 && strcmp(argv[1], "bench") == 0)
+  {
+    srand((unsigned int)time(NULL));
+    bench((argc > 2) ? (size_t)atol(argv[2]) : BENCH_MAX);
+    return 0;
+  }
+
+  // Threshold tuning mode: tp1_8_polynomial tune
+  if (argc > 1 && strcmp(argv[1], "tune") == 0)
+  {
+    tune();
+    return 0;
+  }
+
   double *a = malloc(N * sizeof(double));
   double *b = malloc(N * sizeof(double));
   double *c_ref = malloc((2 * N - 1) * sizeof(double));
@@ -97,6 +840,53 @@ int main()
   }
   printf("OK results :-)\n");
 
+  // Auto path: time and error growth against the reference, on both sides
+  // of the threshold (direct below, FFT from POLY_FFT_THRESHOLD on)
+  size_t sizes[3 + POLY_ERROR_SIZES] = {POLY_FFT_THRESHOLD / 4, POLY_FFT_THRESHOLD - 1,
+                                        POLY_FFT_THRESHOLD};
+  for (size_t k = 0; k < POLY_ERROR_SIZES; k++)
+    sizes[3 + k] = (size_t)N << k;
+
+  printf("%10s %6s %14s %14s %14s\n", "Length", "Path", "Reference (s)", "Auto (s)",
+         "Error");
+  for (size_t k = 0; k < 3 + POLY_ERROR_SIZES; k++)
+  {
+    size_t n = sizes[k];
+    double *x = malloc(n * sizeof(double));
+    double *y = malloc(n * sizeof(double));
+    double *r = malloc((2 * n - 1) * sizeof(double));
+    double *z = malloc((2 * n - 1) * sizeof(double));
+    double time_auto, error;
+
+    for (size_t i = 0; i < n; i++)
+    {
+      x[i] = (float)rand() / (float)(RAND_MAX / MAX_VAL);
+      y[i] = (float)rand() / (float)(RAND_MAX / MAX_VAL);
+    }
+
+    time_reference = omp_get_wtime();
+    polynomial_multiply_direct(r, n, x, n, y);
+    time_reference = omp_get_wtime() - time_reference;
+
+    time_auto = omp_get_wtime();
+    polynomial_multiply_auto(z, n, x, n, y);
+    time_auto = omp_get_wtime() - time_auto;
+
+    error = normwise_error(2 * n - 1, r, z);
+    printf("%10zu %6s %14.5lf %14.5lf %14.3le\n", n,
+           (n >= POLY_FFT_THRESHOLD) ? "FFT" : "direct", time_reference, time_auto, error);
+    if (!(error <= FFT_ERROR))
+    {
+      printf("Bad auto results :-(((\n");
+      exit(1);
+    }
+    free(x);
+    free(y);
+    free(r);
+    free(z);
+  }
+  printf("OK auto results :-)\n");
+
   free(a);
   free(b);
   free(c_ref);
@@ -0,0 +1,381 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <omp.h>
+#define max(x, y) ((x) > (y) ? (x) : (y))
+#define min(x, y) ((x) < (y) ? (x) : (y))
+#define HYPERTHREADING 1 // 1 if hyperthreading is on, 0 otherwise
+#define MAX_VAL 5        // Random values are [0, MAX_VAL]
+
+// Default problem (runtime values: see info)
+#define DEFAULT_N2D   4096 // Side of the 2D grid
+#define DEFAULT_N3D   256  // Side of the 3D grid
+#define DEFAULT_STEPS 16   // Number of Jacobi sweeps
+
+// Temporal blocking parameters
+#define TB_STEPS  4   // Time steps applied per tile while it is in cache
+#define TB_TILE_X 256 // Tile width (x)
+#define TB_TILE_Y 32  // Tile height (y, 3D only)
+
+char info[] = "\
+Usage:\n\
+      tp1_9_jacobi dims nx ny nz steps\n\
+\n\
+      dims     : 2 (5-point stencil) or 3 (7-point stencil)\n\
+      nx,ny,nz : dimensions of the grid (nz ignored in 2D)\n\
+      steps    : number of Jacobi sweeps\n\
+\n\
+Without arguments, runs a 4096x4096 2D grid then a 256^3 3D grid.\n\
+";
+
+/**
+ * Jacobi sweeps:
+ * a grid of nz slabs of ny rows of nx points (2D: nz = 1 is not used, the
+ * grid is ny rows of nx points and a "slab" is a row). Boundary points are
+ * fixed, every interior point is replaced by the mean of its 4 (2D) or 6
+ * (3D) neighbors of the previous sweep. u holds the initial grid and the
+ * result, tmp is a work grid of the same size. All the kernels compute the
+ * same floating point operations in the same order as the reference.
+ */
+
+// Reference computation kernel
+void jacobi2d_reference(size_t nx, size_t ny, size_t steps, double *u, double *tmp)
+{
+  for (size_t t = 0; t < steps; t++)
+  {
+    double (*in)[nx] = (double(*)[nx])u;
+    double (*out)[nx] = (double(*)[nx])tmp;
+
+    for (size_t i = 0; i < ny; i++)
+    {
+      for (size_t j = 0; j < nx; j++)
+      {
+        if ((i == 0) || (i == ny - 1) || (j == 0) || (j == nx - 1))
+          out[i][j] = in[i][j];
+        else
+          out[i][j] = 0.25 * (in[i - 1][j] + in[i + 1][j] + in[i][j - 1] + in[i][j + 1]);
+      }
+    }
+    double *swap = u;
+    u = tmp;
+    tmp = swap;
+  }
+  if (steps % 2 == 1)
+    for (size_t i = 0; i < nx * ny; i++)
+      tmp[i] = u[i];
+}
+
+void jacobi3d_reference(size_t nx, size_t ny, size_t nz, size_t steps, double *u, double *tmp)
+{
+  for (size_t t = 0; t < steps; t++)
+  {
+    double (*in)[ny][nx] = (double(*)[ny][nx])u;
+    double (*out)[ny][nx] = (double(*)[ny][nx])tmp;
+
+    for (size_t k = 0; k < nz; k++)
+    {
+      for (size_t i = 0; i < ny; i++)
+      {
+        for (size_t j = 0; j < nx; j++)
+        {
+          if ((k == 0) || (k == nz - 1) || (i == 0) || (i == ny - 1) ||
+              (j == 0) || (j == nx - 1))
+            out[k][i][j] = in[k][i][j];
+          else
+            out[k][i][j] = (in[k - 1][i][j] + in[k + 1][i][j] +
+                            in[k][i - 1][j] + in[k][i + 1][j] +
+                            in[k][i][j - 1] + in[k][i][j + 1]) / 6.;
+        }
+      }
+    }
+    double *swap = u;
+    u = tmp;
+    tmp = swap;
+  }
+  if (steps % 2 == 1)
+    for (size_t i = 0; i < nx * ny * nz; i++)
+      tmp[i] = u[i];
+}
+
+/**
+ * jacobi_slab function:
+ * this function computes the rows [y0, y1) x columns [x0, x1) of one slab
+ * from the three slabs lo, mid, hi of the previous sweep. Coordinates are
+ * global, the buffers are indexed from the origin (ey0, ex0) with a pitch
+ * ip (inputs) or op (output), so that tiles in private buffers and in the
+ * full grid are handled alike. Points on the boundary of the slab (x, and
+ * y in 3D) are copied from mid.
+ */
+static void jacobi_slab(int dims, size_t nx, size_t ny, size_t ey0, size_t ex0,
+                        size_t y0, size_t y1, size_t x0, size_t x1,
+                        size_t ip, double *lo, double *mid, double *hi,
+                        size_t op, double *out)
+{
+  for (size_t y = y0; y < y1; y++)
+  {
+    double *l = lo + (y - ey0) * ip - ex0;
+    double *m = mid + (y - ey0) * ip - ex0;
+    double *h = hi + (y - ey0) * ip - ex0;
+    double *o = out + (y - ey0) * op - ex0;
+    size_t xi0 = max(x0, 1), xi1 = min(x1, nx - 1);
+
+    if ((dims == 3) && ((y == 0) || (y == ny - 1)))
+    {
+      xi0 = x1;
+      xi1 = x1;
+    }
+    for (size_t x = x0; x < xi0; x++)
+      o[x] = m[x];
+    if (dims == 2)
+    {
+      #pragma omp simd
+      for (size_t x = xi0; x < xi1; x++)
+        o[x] = 0.25 * (l[x] + h[x] + m[x - 1] + m[x + 1]);
+    }
+    else
+    {
+      #pragma omp simd
+      for (size_t x = xi0; x < xi1; x++)
+        o[x] = (l[x] + h[x] + m[x - ip] + m[x + ip] + m[x - 1] + m[x + 1]) / 6.;
+    }
+    for (size_t x = max(xi1, xi0); x < x1; x++)
+      o[x] = m[x];
+  }
+}
+
+// Copies the rows [y0, y1) x columns [x0, x1) of a boundary slab
+static void copy_slab(size_t ey0, size_t ex0, size_t y0, size_t y1, size_t x0, size_t x1,
+                      size_t ip, double *in, size_t op, double *out)
+{
+  for (size_t y = y0; y < y1; y++)
+    for (size_t x = x0; x < x1; x++)
+      out[(y - ey0) * op + x - ex0] = in[(y - ey0) * ip + x - ex0];
+}
+
+/**
+ * jacobi_kernel function:
+ * this function applies steps sweeps with spatial parallelism only: each
+ * sweep distributes the slabs over the threads and streams the whole grid
+ * from memory.
+ * \param dims is 2 or 3
+ * \param nx, ny, nz are the grid dimensions (nz = 1 in 2D)
+ */
+void jacobi_kernel(int dims, size_t nx, size_t ny, size_t nz, size_t steps,
+                   double *u, double *tmp)
+{
+  size_t ns = (dims == 2) ? ny : nz;  // Number of slabs
+  size_t h = (dims == 2) ? 1 : ny;    // Rows per slab
+  size_t slab = h * nx;
+
+  for (size_t t = 0; t < steps; t++)
+  {
+    #pragma omp parallel for schedule(static)
+    for (size_t s = 0; s < ns; s++)
+    {
+      if ((s == 0) || (s == ns - 1))
+        copy_slab(0, 0, 0, h, 0, nx, nx, u + s * slab, nx, tmp + s * slab);
+      else
+        jacobi_slab(dims, nx, ny, 0, 0, 0, h, 0, nx, nx, u + (s - 1) * slab,
+                    u + s * slab, u + (s + 1) * slab, nx, tmp + s * slab);
+    }
+    double *swap = u;
+    u = tmp;
+    tmp = swap;
+  }
+  if (steps % 2 == 1)
+    for (size_t i = 0; i < ns * slab; i++)
+      tmp[i] = u[i];
+}
+
+/**
+ * jacobi_tb_kernel function:
+ * this function applies steps sweeps with temporal blocking. Slabs are cut
+ * in tiles (TB_TILE_X columns, and TB_TILE_Y rows in 3D) distributed over
+ * the threads. For a block of bt <= TB_STEPS sweeps, a thread takes a tile
+ * extended by bt points on each side and walks its slabs as a wavefront:
+ * at step s, sweep l computes slab s - l + 1 from the three slabs of sweep
+ * l - 1 it has just produced, each sweep keeping its last three slabs in
+ * a private ring (cache resident). The extended region shrinks by one
+ * point per sweep so that the last sweep gives the exact tile, which is
+ * the only one written to memory: the grid is read and written once per
+ * bt sweeps instead of once per sweep, for a few redundant halo points.
+ */
+void jacobi_tb_kernel(int dims, size_t nx, size_t ny, size_t nz, size_t steps,
+                      double *u, double *tmp)
+{
+  size_t ns = (dims == 2) ? ny : nz;
+  size_t h = (dims == 2) ? 1 : ny;
+  size_t slab = h * nx;
+  size_t tile_y = (dims == 2) ? 1 : TB_TILE_Y;
+  size_t nb_tiles_x = (nx + TB_TILE_X - 1) / TB_TILE_X;
+  size_t nb_tiles_y = (h + tile_y - 1) / tile_y;
+  size_t ring_h = (dims == 2) ? 1 : tile_y + 2 * TB_STEPS;
+  size_t ring_w = TB_TILE_X + 2 * TB_STEPS;
+  size_t ring_slab = ring_h * ring_w;
+
+  for (size_t t = 0; t < steps; t += TB_STEPS)
+  {
+    size_t bt = min(TB_STEPS, steps - t);
+
+    #pragma omp parallel
+    {
+      // ring[(l - 1) * 3 + r % 3]: slab r of sweep l, 1 <= l < bt
+      double *ring = malloc(3 * TB_STEPS * ring_slab * sizeof(double));
+
+      #pragma omp for collapse(2) schedule(dynamic)
+      for (size_t ty = 0; ty < nb_tiles_y; ty++)
+      {
+        for (size_t tx = 0; tx < nb_tiles_x; tx++)
+        {
+          size_t cy0 = ty * tile_y, cy1 = min(cy0 + tile_y, h);
+          size_t cx0 = tx * TB_TILE_X, cx1 = min(cx0 + TB_TILE_X, nx);
+          size_t halo_y = (dims == 2) ? 0 : bt;
+          size_t ey0 = (cy0 > halo_y) ? cy0 - halo_y : 0;
+          size_t ex0 = (cx0 > bt) ? cx0 - bt : 0;
+          size_t origin = ey0 * nx + ex0;
+
+          for (size_t s = 0; s < ns + bt - 1; s++)
+          {
+            for (size_t l = 1; l <= bt; l++)
+            {
+              if ((s + 1 < l) || (s + 1 - l >= ns))
+                continue;
+              size_t r = s + 1 - l;
+              size_t grow = bt - l; // Extension of the region of sweep l
+              size_t gy = (dims == 2) ? 0 : grow;
+              size_t y0 = (cy0 > gy) ? cy0 - gy : 0, y1 = min(cy1 + gy, h);
+              size_t x0 = (cx0 > grow) ? cx0 - grow : 0, x1 = min(cx1 + grow, nx);
+              double *in[3];
+              double *out;
+              size_t ip, op;
+
+              // Inputs: the grid for sweep 1, the ring of sweep l - 1 otherwise
+              for (int d = 0; d < 3; d++)
+              {
+                size_t rr = (r + d > 0) ? min(r + d - 1, ns - 1) : 0;
+                in[d] = (l == 1) ? u + rr * slab + origin
+                                 : ring + ((l - 2) * 3 + rr % 3) * ring_slab;
+              }
+              ip = (l == 1) ? nx : ring_w;
+              out = (l == bt) ? tmp + r * slab + origin
+                              : ring + ((l - 1) * 3 + r % 3) * ring_slab;
+              op = (l == bt) ? nx : ring_w;
+
+              if ((r == 0) || (r == ns - 1))
+                copy_slab(ey0, ex0, y0, y1, x0, x1, ip, in[1], op, out);
+              else
+                jacobi_slab(dims, nx, h, ey0, ex0, y0, y1, x0, x1,
+                            ip, in[0], in[1], in[2], op, out);
+            }
+          }
+        }
+      }
+      free(ring);
+    }
+    double *swap = u;
+    u = tmp;
+    tmp = swap;
+  }
+  if (((steps + TB_STEPS - 1) / TB_STEPS) % 2 == 1)
+    for (size_t i = 0; i < ns * slab; i++)
+      tmp[i] = u[i];
+}
+
+// Runs and checks the reference and both kernels on one problem
+void run(int dims, size_t nx, size_t ny, size_t nz, size_t steps)
+{
+  size_t size = nx * ny * nz;
+  double *init = malloc(size * sizeof(double));
+  double *ref = malloc(size * sizeof(double));
+  double *u = malloc(size * sizeof(double));
+  double *tmp = malloc(size * sizeof(double));
+  double time_reference, time_kernel, time_tb, speedup, efficiency;
+  double updates = (double)size * steps;
+
+  if (dims == 2)
+    printf("2D grid %zux%zu, %zu steps\n", nx, ny, steps);
+  else
+    printf("3D grid %zux%zux%zu, %zu steps\n", nx, ny, nz, steps);
+
+  for (size_t i = 0; i < size; i++)
+    init[i] = ref[i] = (float)rand() / (float)(RAND_MAX / MAX_VAL);
+
+  time_reference = omp_get_wtime();
+  if (dims == 2)
+    jacobi2d_reference(nx, ny, steps, ref, tmp);
+  else
+    jacobi3d_reference(nx, ny, nz, steps, ref, tmp);
+  time_reference = omp_get_wtime() - time_reference;
+  printf("Reference time : %3.5lf s (%.1lf Mupdates/s)\n",
+         time_reference, updates / time_reference * 1.e-6);
+
+  for (size_t i = 0; i < size; i++)
+    u[i] = init[i];
+  time_kernel = omp_get_wtime();
+  jacobi_kernel(dims, nx, ny, nz, steps, u, tmp);
+  time_kernel = omp_get_wtime() - time_kernel;
+  printf("Kernel time -- : %3.5lf s (%.1lf Mupdates/s)\n",
+         time_kernel, updates / time_kernel * 1.e-6);
+  for (size_t i = 0; i < size; i++)
+  {
+    if (ref[i] != u[i])
+    {
+      printf("Bad results :-(((\n");
+      exit(1);
+    }
+  }
+
+  for (size_t i = 0; i < size; i++)
+    u[i] = init[i];
+  time_tb = omp_get_wtime();
+  jacobi_tb_kernel(dims, nx, ny, nz, steps, u, tmp);
+  time_tb = omp_get_wtime() - time_tb;
+  printf("Blocked time - : %3.5lf s (%.1lf Mupdates/s)\n",
+         time_tb, updates / time_tb * 1.e-6);
+  for (size_t i = 0; i < size; i++)
+  {
+    if (ref[i] != u[i])
+    {
+      printf("Bad blocked results :-(((\n");
+      exit(1);
+    }
+  }
+
+  speedup = time_reference / time_tb;
+  efficiency = speedup / (omp_get_num_procs() / (1 + HYPERTHREADING));
+  printf("Speedup ------ : %3.5lf\n", speedup);
+  printf("Efficiency --- : %3.5lf\n", efficiency);
+  printf("OK results :-)\n\n");
+
+  free(init);
+  free(ref);
+  free(u);
+  free(tmp);
+}
+
+int main(int argc, char *argv[])
+{
+  srand((unsigned int)time(NULL));
+
+  if (argc == 1)
+  {
+    fprintf(stderr, "%s\n", info);
+    run(2, DEFAULT_N2D, DEFAULT_N2D, 1, DEFAULT_STEPS);
+    run(3, DEFAULT_N3D, DEFAULT_N3D, DEFAULT_N3D, DEFAULT_STEPS);
+    return 0;
+  }
+
+  int dims = atoi(argv[1]);
+  size_t nx = (argc > 2) ? (size_t)atol(argv[2]) : DEFAULT_N2D;
+  size_t ny = (argc > 3) ? (size_t)atol(argv[3]) : nx;
+  size_t nz = (argc > 4) ? (size_t)atol(argv[4]) : nx;
+  size_t steps = (argc > 5) ? (size_t)atol(argv[5]) : DEFAULT_STEPS;
+
+  if (((dims != 2) && (dims != 3)) || (nx < 3) || (ny < 3) || ((dims == 3) && (nz < 3)))
+  {
+    fprintf(stderr, "%s\n", info);
+    return 1;
+  }
+  run(dims, nx, ny, (dims == 2) ? 1 : nz, steps);
+  return 0;
+}
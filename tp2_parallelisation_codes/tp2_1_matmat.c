@@ -1,11 +1,29 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
 #include <time.h>
 #include <omp.h>
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86 1
+#endif
+#define min(x, y) ((x) < (y) ? (x) : (y))
 #define HYPERTHREADING 1 // 1 if hyperthreading is on, 0 otherwise
 #define ERROR 1.e-20     // Acceptable precision
+#define REL_ERROR 1.e-12 // Acceptable relative precision (reordered sums)
+#define STRASSEN_ERROR 1.e-10 // Acceptable normwise precision (Strassen)
 #define MAX_VAL 5        // Random values are [0, MAX_VAL]
 
+// GEMM blocking parameters (multiples of every MR and NR below)
+#define GEMM_MC 96   // Rows of the packed A block (L2)
+#define GEMM_KC 256  // Depth of the packed blocks (A sliver + B sliver in L1)
+#define GEMM_NC 2048 // Columns of the packed B block (L3)
+
 // Matrix and vector sizes
 #define N 1000
 
@@ -48,13 +66,1077 @@ void matmat_kernel(double C[N][N], double A[N][N], double B[N][N])
   }
 }
 
-int main()
+/**
+ * GEMM:
+ * C = A.B for row-major matrices (m x k, k x n, leading dimensions lda,
+ * ldb, ldc), organized as in BLIS: the loops over n (GEMM_NC), k
+ * (GEMM_KC) and m (GEMM_MC) cut the matrices into blocks that are packed
+ * into contiguous buffers, A in slivers of MR rows, B in slivers of NR
+ * columns (zero padded), stored in the order the micro-kernel reads them.
+ * The micro-kernel computes an MR x NR tile of C in registers with FMAs,
+ * one broadcast of A and NR / (vector width) loads of B per row and per k.
+ * The packed B block is shared, threads get GEMM_MC blocks of rows of A.
+ * The micro-kernel (and MR, NR) is selected at startup by gemm_init.
+ */
+typedef void (*gemm_ukernel)(size_t kc, double *Ap, double *Bp, double *C, size_t ldc);
+
+static void ukernel_generic(size_t kc, double *Ap, double *Bp, double *C, size_t ldc)
+{
+  double c[4][8] = {{0.}};
+
+  for (size_t p = 0; p < kc; p++)
+  {
+    for (size_t r = 0; r < 4; r++)
+      for (size_t j = 0; j < 8; j++)
+        c[r][j] += Ap[r] * Bp[j];
+    Ap += 4;
+    Bp += 8;
+  }
+  for (size_t r = 0; r < 4; r++)
+    for (size_t j = 0; j < 8; j++)
+      C[r * ldc + j] += c[r][j];
+}
+
+#ifdef SIMD_X86
+__attribute__((target("avx2,fma")))
+static void ukernel_avx2(size_t kc, double *Ap, double *Bp, double *C, size_t ldc)
+{
+  __m256d c[6][2];
+
+  for (size_t r = 0; r < 6; r++)
+    c[r][0] = c[r][1] = _mm256_setzero_pd();
+  for (size_t p = 0; p < kc; p++)
+  {
+    __m256d b0 = _mm256_load_pd(Bp);
+    __m256d b1 = _mm256_load_pd(Bp + 4);
+    for (size_t r = 0; r < 6; r++)
+    {
+      __m256d a = _mm256_broadcast_sd(Ap + r);
+      c[r][0] = _mm256_fmadd_pd(a, b0, c[r][0]);
+      c[r][1] = _mm256_fmadd_pd(a, b1, c[r][1]);
+    }
+    Ap += 6;
+    Bp += 8;
+  }
+  for (size_t r = 0; r < 6; r++)
+  {
+    _mm256_storeu_pd(C + r * ldc, _mm256_add_pd(_mm256_loadu_pd(C + r * ldc), c[r][0]));
+    _mm256_storeu_pd(C + r * ldc + 4, _mm256_add_pd(_mm256_loadu_pd(C + r * ldc + 4), c[r][1]));
+  }
+}
+
+__attribute__((target("avx512f")))
+static void ukernel_avx512(size_t kc, double *Ap, double *Bp, double *C, size_t ldc)
+{
+  __m512d c[12][2];
+
+  for (size_t r = 0; r < 12; r++)
+    c[r][0] = c[r][1] = _mm512_setzero_pd();
+  for (size_t p = 0; p < kc; p++)
+  {
+    __m512d b0 = _mm512_load_pd(Bp);
+    __m512d b1 = _mm512_load_pd(Bp + 8);
+    for (size_t r = 0; r < 12; r++)
+    {
+      __m512d a = _mm512_set1_pd(Ap[r]);
+      c[r][0] = _mm512_fmadd_pd(a, b0, c[r][0]);
+      c[r][1] = _mm512_fmadd_pd(a, b1, c[r][1]);
+    }
+    Ap += 12;
+    Bp += 16;
+  }
+  for (size_t r = 0; r < 12; r++)
+  {
+    _mm512_storeu_pd(C + r * ldc, _mm512_add_pd(_mm512_loadu_pd(C + r * ldc), c[r][0]));
+    _mm512_storeu_pd(C + r * ldc + 8, _mm512_add_pd(_mm512_loadu_pd(C + r * ldc + 8), c[r][1]));
+  }
+}
+#endif
+
+static gemm_ukernel gemm_kernel = ukernel_generic;
+static size_t gemm_mr = 4, gemm_nr = 8;
+static const char *gemm_isa = "generic";
+
+// Selects the widest micro-kernel supported by the CPU (CPUID)
+void gemm_init(void)
+{
+#ifdef SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+  {
+    gemm_kernel = ukernel_avx512;
+    gemm_mr = 12;
+    gemm_nr = 16;
+    gemm_isa = "avx512";
+  }
+  else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+  {
+    gemm_kernel = ukernel_avx2;
+    gemm_mr = 6;
+    gemm_nr = 8;
+    gemm_isa = "avx2";
+  }
+#endif
+}
+
+// Packs rows [0, mc) x columns [0, kc) of A in slivers of mr rows
+static void pack_A(size_t mc, size_t kc, double *A, size_t lda, double *Ap, size_t mr)
+{
+  for (size_t i = 0; i < mc; i += mr)
+    for (size_t p = 0; p < kc; p++)
+      for (size_t r = 0; r < mr; r++)
+        *Ap++ = (i + r < mc) ? A[(i + r) * lda + p] : 0.;
+}
+
+// Packs rows [0, kc) x columns [j, j + nr) of B (a sliver of B, nc columns)
+static void pack_B_sliver(size_t kc, size_t nc, double *B, size_t ldb, double *Bp,
+                          size_t nr, size_t j)
+{
+  double *dst = Bp + j * kc;
+  for (size_t p = 0; p < kc; p++)
+    for (size_t c = 0; c < nr; c++)
+      *dst++ = (j + c < nc) ? B[p * ldb + j + c] : 0.;
+}
+
+// C (mc x nc) += packed A block x packed B block, tile by tile
+static void gemm_macro(size_t mc, size_t nc, size_t kc, double *Ap, double *Bp,
+                       double *C, size_t ldc)
+{
+  size_t mr = gemm_mr, nr = gemm_nr;
+  double tile[12 * 16]; // Edge tiles, large enough for every micro-kernel
+
+  for (size_t jr = 0; jr < nc; jr += nr)
+  {
+    for (size_t ir = 0; ir < mc; ir += mr)
+    {
+      double *Cij = C + ir * ldc + jr;
+      double *Apr = Ap + ir * kc, *Bpr = Bp + jr * kc;
+      if ((ir + mr <= mc) && (jr + nr <= nc))
+        gemm_kernel(kc, Apr, Bpr, Cij, ldc);
+      else
+      {
+        size_t rows = min(mr, mc - ir), cols = min(nr, nc - jr);
+        for (size_t t = 0; t < mr * nr; t++)
+          tile[t] = 0.;
+        gemm_kernel(kc, Apr, Bpr, tile, nr);
+        for (size_t r = 0; r < rows; r++)
+          for (size_t c = 0; c < cols; c++)
+            Cij[r * ldc + c] += tile[r * nr + c];
+      }
+    }
+  }
+}
+
+// Size of the packing buffers of gemm_parallel (doubles): the B block and
+// one A block per thread
+size_t gemm_buffer_size(void)
+{
+  return GEMM_KC * GEMM_NC + (size_t)omp_get_max_threads() * GEMM_MC * GEMM_KC;
+}
+
+// C = A.B (overwrite = 1) or C += A.B (overwrite = 0), packing in buffer
+// (gemm_buffer_size() doubles, 64-byte aligned) or in allocated buffers
+static void gemm_parallel(size_t m, size_t n, size_t k, double *A, size_t lda,
+                          double *B, size_t ldb, double *C, size_t ldc, int overwrite,
+                          double *buffer)
+{
+  size_t mr = gemm_mr, nr = gemm_nr;
+  double *Bp = (buffer != NULL) ? buffer
+                                : aligned_alloc(64, gemm_buffer_size() * sizeof(double));
+
+  #pragma omp parallel
+  {
+    double *Ap = Bp + GEMM_KC * GEMM_NC + omp_get_thread_num() * GEMM_MC * GEMM_KC;
+
+    if (overwrite)
+    {
+      #pragma omp for schedule(static)
+      for (size_t i = 0; i < m; i++)
+        for (size_t j = 0; j < n; j++)
+          C[i * ldc + j] = 0.;
+    }
+
+    for (size_t jc = 0; jc < n; jc += GEMM_NC)
+    {
+      size_t nc = min(GEMM_NC, n - jc);
+      for (size_t pc = 0; pc < k; pc += GEMM_KC)
+      {
+        size_t kc = min(GEMM_KC, k - pc);
+
+        #pragma omp for schedule(static)
+        for (size_t j = 0; j < nc; j += nr)
+          pack_B_sliver(kc, nc, B + pc * ldb + jc, ldb, Bp, nr, j);
+
+        #pragma omp for schedule(dynamic)
+        for (size_t ic = 0; ic < m; ic += GEMM_MC)
+        {
+          size_t mc = min(GEMM_MC, m - ic);
+          pack_A(mc, kc, A + ic * lda + pc, lda, Ap, mr);
+          gemm_macro(mc, nc, kc, Ap, Bp, C + ic * ldc + jc, ldc);
+        } // Implicit barrier: Bp is repacked after every thread is done
+      }
+    }
+  }
+  if (buffer == NULL)
+    free(Bp);
+}
+
+void gemm(size_t m, size_t n, size_t k, double *A, size_t lda, double *B, size_t ldb,
+          double *C, size_t ldc)
+{
+  gemm_parallel(m, n, k, A, lda, B, ldb, C, ldc, 1, NULL);
+}
+
+// Same as gemm but accumulates: C += A.B, packing in buffer if not NULL
+// (gemm_buffer_size() doubles, 64-byte aligned), e.g. across repeated calls
+void gemm_update(size_t m, size_t n, size_t k, double *A, size_t lda, double *B,
+                 size_t ldb, double *C, size_t ldc, double *buffer)
+{
+  gemm_parallel(m, n, k, A, lda, B, ldb, C, ldc, 0, buffer);
+}
+
+// Size of the packing buffers of gemm_serial for n columns (doubles)
+size_t gemm_serial_buffer(size_t n)
+{
+  size_t nc = min(GEMM_NC, n);
+  return GEMM_MC * GEMM_KC + GEMM_KC * ((nc + gemm_nr - 1) / gemm_nr * gemm_nr);
+}
+
+/**
+ * gemm_serial function:
+ * same as gemm in the calling thread only (e.g. inside a task), with the
+ * packing buffers taken from buffer (gemm_serial_buffer(n) doubles,
+ * 64-byte aligned) instead of being allocated.
+ */
+void gemm_serial(size_t m, size_t n, size_t k, double *A, size_t lda, double *B,
+                 size_t ldb, double *C, size_t ldc, double *buffer)
 {
+  size_t mr = gemm_mr, nr = gemm_nr;
+  double *Ap = buffer, *Bp = buffer + GEMM_MC * GEMM_KC;
+
+  for (size_t i = 0; i < m; i++)
+    for (size_t j = 0; j < n; j++)
+      C[i * ldc + j] = 0.;
+
+  for (size_t jc = 0; jc < n; jc += GEMM_NC)
+  {
+    size_t nc = min(GEMM_NC, n - jc);
+    for (size_t pc = 0; pc < k; pc += GEMM_KC)
+    {
+      size_t kc = min(GEMM_KC, k - pc);
+      for (size_t j = 0; j < nc; j += nr)
+        pack_B_sliver(kc, nc, B + pc * ldb + jc, ldb, Bp, nr, j);
+      for (size_t ic = 0; ic < m; ic += GEMM_MC)
+      {
+        size_t mc = min(GEMM_MC, m - ic);
+        pack_A(mc, kc, A + ic * lda + pc, lda, Ap, mr);
+        gemm_macro(mc, nc, kc, Ap, Bp, C + ic * ldc + jc, ldc);
+      }
+    }
+  }
+}
+
+/**
+ * Strassen-Winograd:
+ * C = A.B for square matrices with 7 products of half size instead of 8
+ * (15 additions), recursively down to a cutoff where gemm_serial is used.
+ * With quadrants X11, X12, X21, X22:
+ *   S1 = A21 + A22, S2 = S1 - A11, S3 = A11 - A21, S4 = A12 - S2,
+ *   T1 = B12 - B11, T2 = B22 - T1, T3 = B22 - B12, T4 = T2 - B21,
+ *   M1 = A11 B11, M2 = A12 B21, M3 = S4 B22, M4 = A22 T4,
+ *   M5 = S1 T1, M6 = S2 T2, M7 = S3 T3, U2 = M1 + M6, U3 = U2 + M7,
+ *   C11 = M1 + M2, C12 = U2 + M5 + M3, C21 = U3 - M4, C22 = U3 + M5.
+ * The first STRASSEN_TASK_DEPTH levels run the 7 products as concurrent
+ * OpenMP tasks: the 8 sums S1..T4 and M1, M6, M7 get their own h x h
+ * temporaries (11 h^2, h = n / 2) and every product its own slice of the
+ * arena for its recursion. Deeper levels run the products one after the
+ * other with the schedule of Douglas et al., which keeps every
+ * intermediate result in the quadrants of C or in two temporaries X (sums
+ * of A) and Y (sums of B): 2 h^2 per level. Additions and base-case
+ * products are also split into tasks (taskloop), the latter by GEMM_MC x
+ * STRASSEN_NB blocks of C, each task packing in a buffer of the thread
+ * running it. The whole workspace is a single arena allocated once, the
+ * recursion never calls malloc.
+ */
+#define STRASSEN_CUTOFF 512     // Default largest size multiplied by gemm_serial
+#define STRASSEN_MIN_CUTOFF 32  // Smallest cutoff (below, recursion overhead only)
+#define STRASSEN_TASK_DEPTH 1   // Recursion levels running their products as tasks
+#define STRASSEN_NB 128         // Columns of the base-case blocks run as tasks
+#define STRASSEN_N 2048       // Default size of the "strassen" mode
+
+// Size of the zero-padded matrices: c 2^d, c = ceil(n / 2^d) <= cutoff
+size_t strassen_padded_size(size_t n, size_t cutoff)
+{
+  size_t levels = 0;
+  while ((n + ((size_t)1 << levels) - 1) >> levels > cutoff)
+    levels++;
+  return ((n + ((size_t)1 << levels) - 1) >> levels) << levels;
+}
+
+// Temporaries (doubles) of the recursion for a product of size n at depth
+static size_t strassen_temporaries(size_t n, size_t cutoff, int depth)
+{
+  if (n <= cutoff)
+    return 0;
+  size_t h = n / 2;
+  size_t child = strassen_temporaries(h, cutoff, depth + 1);
+  return (depth < STRASSEN_TASK_DEPTH) ? 11 * h * h + 7 * child : 2 * h * h + child;
+}
+
+// Packing buffer (doubles) of a thread, a multiple of 64 bytes
+static size_t strassen_buffer(void)
+{
+  return (gemm_serial_buffer(STRASSEN_NB) + 7) / 8 * 8;
+}
+
+// Arena size (doubles) of strassen for n x n matrices
+size_t strassen_arena_size(size_t n, size_t cutoff)
+{
+  size_t s = strassen_padded_size(n, cutoff);
+  return strassen_temporaries(s, cutoff, 0) + omp_get_max_threads() * strassen_buffer() + 8;
+}
+
+// Z = X + Y (sign = 1) or Z = X - Y (sign = -1), h x h, Z may be X or Y
+static void mat_addsub(size_t h, double *X, size_t ldx, double *Y, size_t ldy,
+                       double *Z, size_t ldz, double sign)
+{
+  #pragma omp taskloop
+  for (size_t i = 0; i < h; i++)
+  {
+    #pragma omp simd
+    for (size_t j = 0; j < h; j++)
+      Z[i * ldz + j] = X[i * ldx + j] + sign * Y[i * ldy + j];
+  }
+}
+
+// C = A.B (n <= cutoff), one task per GEMM_MC x STRASSEN_NB block of C
+static void strassen_leaf(size_t n, double *A, size_t lda, double *B, size_t ldb,
+                          double *C, size_t ldc, double *buffers)
+{
+  #pragma omp taskloop collapse(2)
+  for (size_t ic = 0; ic < n; ic += GEMM_MC)
+    for (size_t jc = 0; jc < n; jc += STRASSEN_NB)
+      gemm_serial(min(GEMM_MC, n - ic), min(STRASSEN_NB, n - jc), n, A + ic * lda, lda,
+                  B + jc, ldb, C + ic * ldc + jc, ldc,
+                  buffers + omp_get_thread_num() * strassen_buffer());
+}
+
+static void strassen_rec(size_t n, double *A, size_t lda, double *B, size_t ldb,
+                         double *C, size_t ldc, double *arena, double *buffers,
+                         size_t cutoff, int depth);
+
+// Top levels: the 7 products as tasks, each with its own temporaries
+static void strassen_tasks(size_t n, double *A, size_t lda, double *B, size_t ldb,
+                           double *C, size_t ldc, double *arena, double *buffers,
+                           size_t cutoff, int depth)
+{
+  size_t h = n / 2, hh = h * h;
+  double *A11 = A, *A12 = A + h, *A21 = A + h * lda, *A22 = A21 + h;
+  double *B11 = B, *B12 = B + h, *B21 = B + h * ldb, *B22 = B21 + h;
+  double *C11 = C, *C12 = C + h, *C21 = C + h * ldc, *C22 = C21 + h;
+  double *S1 = arena, *S2 = S1 + hh, *S3 = S2 + hh, *S4 = S3 + hh;
+  double *T1 = S4 + hh, *T2 = T1 + hh, *T3 = T2 + hh, *T4 = T3 + hh;
+  double *X1 = T4 + hh, *X6 = X1 + hh, *X7 = X6 + hh;
+  size_t child = strassen_temporaries(h, cutoff, depth + 1);
+  double *P[7];
+  for (int t = 0; t < 7; t++)
+    P[t] = X7 + hh + t * child;
+
+  #pragma omp task
+  {
+    mat_addsub(h, A21, lda, A22, lda, S1, h, 1.);
+    mat_addsub(h, S1, h, A11, lda, S2, h, -1.);
+    mat_addsub(h, A11, lda, A21, lda, S3, h, -1.);
+    mat_addsub(h, A12, lda, S2, h, S4, h, -1.);
+  }
+  #pragma omp task
+  {
+    mat_addsub(h, B12, ldb, B11, ldb, T1, h, -1.);
+    mat_addsub(h, B22, ldb, T1, h, T2, h, -1.);
+    mat_addsub(h, B22, ldb, B12, ldb, T3, h, -1.);
+    mat_addsub(h, T2, h, B21, ldb, T4, h, -1.);
+  }
+  #pragma omp taskwait
+
+  #pragma omp task
+  strassen_rec(h, A11, lda, B11, ldb, X1, h, P[0], buffers, cutoff, depth + 1);
+  #pragma omp task
+  strassen_rec(h, A12, lda, B21, ldb, C11, ldc, P[1], buffers, cutoff, depth + 1);
+  #pragma omp task
+  strassen_rec(h, S4, h, B22, ldb, C12, ldc, P[2], buffers, cutoff, depth + 1);
+  #pragma omp task
+  strassen_rec(h, A22, lda, T4, h, C21, ldc, P[3], buffers, cutoff, depth + 1);
+  #pragma omp task
+  strassen_rec(h, S1, h, T1, h, C22, ldc, P[4], buffers, cutoff, depth + 1);
+  #pragma omp task
+  strassen_rec(h, S2, h, T2, h, X6, h, P[5], buffers, cutoff, depth + 1);
+  #pragma omp task
+  strassen_rec(h, S3, h, T3, h, X7, h, P[6], buffers, cutoff, depth + 1);
+  #pragma omp taskwait
+
+  // X1 = M1, C11 = M2, C12 = M3, C21 = M4, C22 = M5, X6 = M6, X7 = M7
+  mat_addsub(h, C11, ldc, X1, h, C11, ldc, 1.);  // C11 = M1 + M2
+  mat_addsub(h, X6, h, X1, h, X6, h, 1.);        // X6 = U2 = M1 + M6
+  mat_addsub(h, X7, h, X6, h, X7, h, 1.);        // X7 = U3 = U2 + M7
+  mat_addsub(h, X6, h, C22, ldc, X6, h, 1.);     // X6 = U4 = U2 + M5
+  mat_addsub(h, C22, ldc, X7, h, C22, ldc, 1.);  // C22 = U3 + M5
+  mat_addsub(h, C12, ldc, X6, h, C12, ldc, 1.);  // C12 = U4 + M3
+  mat_addsub(h, X7, h, C21, ldc, C21, ldc, -1.); // C21 = U3 - M4
+}
+
+static void strassen_rec(size_t n, double *A, size_t lda, double *B, size_t ldb,
+                         double *C, size_t ldc, double *arena, double *buffers,
+                         size_t cutoff, int depth)
+{
+  if (n <= cutoff)
+  {
+    strassen_leaf(n, A, lda, B, ldb, C, ldc, buffers);
+    return;
+  }
+  if (depth < STRASSEN_TASK_DEPTH)
+  {
+    strassen_tasks(n, A, lda, B, ldb, C, ldc, arena, buffers, cutoff, depth);
+    return;
+  }
+
+  // Douglas schedule: products one after the other, temporaries X and Y
+  size_t h = n / 2;
+  double *A11 = A, *A12 = A + h, *A21 = A + h * lda, *A22 = A21 + h;
+  double *B11 = B, *B12 = B + h, *B21 = B + h * ldb, *B22 = B21 + h;
+  double *C11 = C, *C12 = C + h, *C21 = C + h * ldc, *C22 = C21 + h;
+  double *X = arena, *Y = X + h * h, *next = Y + h * h;
+  int d = depth + 1;
+
+  mat_addsub(h, A11, lda, A21, lda, X, h, -1.);                            // X = S3
+  mat_addsub(h, B22, ldb, B12, ldb, Y, h, -1.);                            // Y = T3
+  strassen_rec(h, X, h, Y, h, C21, ldc, next, buffers, cutoff, d);         // C21 = M7
+  mat_addsub(h, A21, lda, A22, lda, X, h, 1.);                             // X = S1
+  mat_addsub(h, B12, ldb, B11, ldb, Y, h, -1.);                            // Y = T1
+  strassen_rec(h, X, h, Y, h, C22, ldc, next, buffers, cutoff, d);         // C22 = M5
+  mat_addsub(h, X, h, A11, lda, X, h, -1.);                                // X = S2
+  mat_addsub(h, B22, ldb, Y, h, Y, h, -1.);                                // Y = T2
+  strassen_rec(h, X, h, Y, h, C12, ldc, next, buffers, cutoff, d);         // C12 = M6
+  mat_addsub(h, A12, lda, X, h, X, h, -1.);                                // X = S4
+  strassen_rec(h, X, h, B22, ldb, C11, ldc, next, buffers, cutoff, d);     // C11 = M3
+  strassen_rec(h, A11, lda, B11, ldb, X, h, next, buffers, cutoff, d);     // X = M1
+  mat_addsub(h, X, h, C12, ldc, C12, ldc, 1.);                             // C12 = U2 = M1 + M6
+  mat_addsub(h, C12, ldc, C21, ldc, C21, ldc, 1.);                         // C21 = U3 = U2 + M7
+  mat_addsub(h, C12, ldc, C22, ldc, C12, ldc, 1.);                         // C12 = U4 = U2 + M5
+  mat_addsub(h, C21, ldc, C22, ldc, C22, ldc, 1.);                         // C22 = U3 + M5
+  mat_addsub(h, C12, ldc, C11, ldc, C12, ldc, 1.);                         // C12 = U4 + M3
+  mat_addsub(h, Y, h, B21, ldb, Y, h, -1.);                                // Y = T4
+  strassen_rec(h, A22, lda, Y, h, C11, ldc, next, buffers, cutoff, d);     // C11 = M4
+  mat_addsub(h, C21, ldc, C11, ldc, C21, ldc, -1.);                        // C21 = U3 - M4
+  strassen_rec(h, A12, lda, B21, ldb, C11, ldc, next, buffers, cutoff, d); // C11 = M2
+  mat_addsub(h, X, h, C11, ldc, C11, ldc, 1.);                             // C11 = M1 + M2
+}
+
+/**
+ * strassen function:
+ * this function computes C = A.B for n x n row-major matrices. n does not
+ * need to be a power of 2: matrices are padded with zeros to the size
+ * c 2^d where 2^d is the number of halvings needed to reach the cutoff
+ * and c = ceil(n / 2^d) <= cutoff, i.e. less than 2^d extra rows.
+ * \param cutoff is the largest size multiplied directly (gemm_serial),
+ *        at least STRASSEN_MIN_CUTOFF (smaller values are raised to it)
+ */
+void strassen(size_t n, double *A, double *B, double *C, size_t cutoff)
+{
+  cutoff = (cutoff > STRASSEN_MIN_CUTOFF) ? cutoff : STRASSEN_MIN_CUTOFF;
+  size_t s = strassen_padded_size(n, cutoff);
+  double *Ap = A, *Bp = B, *Cp = C;
+
+  if (s != n)
+  {
+    Ap = calloc(s * s, sizeof(double));
+    Bp = calloc(s * s, sizeof(double));
+    Cp = malloc(s * s * sizeof(double));
+    for (size_t i = 0; i < n; i++)
+      for (size_t j = 0; j < n; j++)
+      {
+        Ap[i * s + j] = A[i * n + j];
+        Bp[i * s + j] = B[i * n + j];
+      }
+  }
+
+  size_t temporaries = strassen_temporaries(s, cutoff, 0);
+  double *arena = malloc(strassen_arena_size(n, cutoff) * sizeof(double));
+  double *buffers = (double *)(((uintptr_t)(arena + temporaries) + 63) & ~(uintptr_t)63);
+  #pragma omp parallel
+  #pragma omp single
+  strassen_rec(s, Ap, s, Bp, s, Cp, s, arena, buffers, cutoff, 0);
+  free(arena);
+
+  if (s != n)
+  {
+    for (size_t i = 0; i < n; i++)
+      for (size_t j = 0; j < n; j++)
+        C[i * n + j] = Cp[i * s + j];
+    free(Ap);
+    free(Bp);
+    free(Cp);
+  }
+}
+
+/**
+ * strassen_benchmark function:
+ * this function times the classical product (gemm) and Strassen-Winograd
+ * on random n x n matrices and prints the maximum error of Strassen
+ * relative to the largest element of the classical result.
+ */
+void strassen_benchmark(size_t n, size_t cutoff)
+{
+  double *A = malloc(n * n * sizeof(double));
+  double *B = malloc(n * n * sizeof(double));
+  double *C = malloc(n * n * sizeof(double));
+  double *ref = malloc(n * n * sizeof(double));
+  double time_gemm, time_strassen, error = 0., norm = 0.;
+  double flops = 2. * n * n * n;
+
+  for (size_t i = 0; i < n * n; i++)
+  {
+    A[i] = (double)rand() / (double)(RAND_MAX / MAX_VAL);
+    B[i] = (double)rand() / (double)(RAND_MAX / MAX_VAL);
+  }
+
+  cutoff = (cutoff > STRASSEN_MIN_CUTOFF) ? cutoff : STRASSEN_MIN_CUTOFF;
+  printf("Size %zu (padded to %zu), cutoff %zu, arena %.1lf MB\n", n,
+         strassen_padded_size(n, cutoff), cutoff,
+         strassen_arena_size(n, cutoff) * sizeof(double) * 1.e-6);
+  time_gemm = omp_get_wtime();
+  gemm(n, n, n, A, n, B, n, ref, n);
+  time_gemm = omp_get_wtime() - time_gemm;
+  printf("GEMM time ---- : %3.5lf s (%.2lf GFLOP/s)\n", time_gemm, flops / time_gemm * 1.e-9);
+
+  time_strassen = omp_get_wtime();
+  strassen(n, A, B, C, cutoff);
+  time_strassen = omp_get_wtime() - time_strassen;
+  printf("Strassen time  : %3.5lf s (%.2lf effective GFLOP/s, speedup %3.5lf)\n",
+         time_strassen, flops / time_strassen * 1.e-9, time_gemm / time_strassen);
+
+  for (size_t i = 0; i < n * n; i++)
+  {
+    error = fmax(error, fabs(ref[i] - C[i]));
+    norm = fmax(norm, fabs(ref[i]));
+  }
+  printf("Max error ---- : %.3le (relative %.3le)\n", error, error / norm);
+  if (error / norm > STRASSEN_ERROR)
+  {
+    printf("Bad Strassen results :-(((\n");
+    exit(1);
+  }
+  printf("OK Strassen results :-)\n");
+
+  free(A);
+  free(B);
+  free(C);
+  free(ref);
+}
+
+/**
+ * Batched small-matrix GEMM:
+ * C_b = A_b.B_b for a batch of count small matrices of the same shape
+ * (A_b is m x k, B_b is k x n). Matrices are interleaved by packs of
+ * BATCH_LANES: element (i, j) of matrix b of a rows x cols batch is at
+ * X[((b / BATCH_LANES) * rows * cols + i * cols + j) * BATCH_LANES + b % BATCH_LANES]
+ * so that the SIMD lanes span BATCH_LANES matrices and every vector load is
+ * contiguous, whatever the (tiny) matrix size. The last pack is padded
+ * with zeros. Common square sizes have a specialized kernel where every
+ * size is a compile-time constant (fully unrolled loops), the other
+ * shapes use the generic kernel.
+ */
+#define BATCH_LANES 8          // Matrices per pack (one AVX-512 register of doubles)
+#define BATCH_COLS 4           // Columns of C accumulated together (reuse of A)
+#define BATCH_ELEMENTS 4194304 // Elements per batch array in the "batch" mode
+#define BATCH_SIZE 8           // Default matrix size of the "batch" mode
+
+#ifdef SIMD_X86
+#define BATCH_CLONES __attribute__((target_clones("avx512f", "arch=haswell", "default")))
+#else
+#define BATCH_CLONES
+#endif
+
+typedef void (*batch_kernel)(size_t packs, const double *A, const double *B, double *C);
+
+// Doubles needed to store count rows x cols matrices in the interleaved layout
+size_t batch_doubles(size_t rows, size_t cols, size_t count)
+{
+  return (count + BATCH_LANES - 1) / BATCH_LANES * rows * cols * BATCH_LANES;
+}
+
+// Interleaves count row-major rows x cols matrices M (one after the other) into X
+void batch_pack(size_t rows, size_t cols, size_t count, const double *M, double *X)
+{
+  size_t packs = (count + BATCH_LANES - 1) / BATCH_LANES, size = rows * cols;
+
+  #pragma omp parallel for schedule(static)
+  for (size_t q = 0; q < packs; q++)
+    for (size_t e = 0; e < size; e++)
+      for (size_t l = 0; l < BATCH_LANES; l++)
+      {
+        size_t b = q * BATCH_LANES + l;
+        X[(q * size + e) * BATCH_LANES + l] = (b < count) ? M[b * size + e] : 0.;
+      }
+}
+
+// Inverse of batch_pack: writes back count row-major matrices into M
+void batch_unpack(size_t rows, size_t cols, size_t count, const double *X, double *M)
+{
+  size_t size = rows * cols;
+
+  #pragma omp parallel for schedule(static)
+  for (size_t b = 0; b < count; b++)
+    for (size_t e = 0; e < size; e++)
+      M[b * size + e] = X[((b / BATCH_LANES) * size + e) * BATCH_LANES + b % BATCH_LANES];
+}
+
+// One pack: BATCH_LANES products, BATCH_COLS columns of C at a time
+static inline __attribute__((always_inline))
+void batch_gemm_pack(size_t m, size_t n, size_t k, const double *restrict A,
+                     const double *restrict B, double *restrict C)
+{
+  for (size_t i = 0; i < m; i++)
+  {
+    for (size_t j = 0; j < n; j += BATCH_COLS)
+    {
+      double acc[BATCH_COLS][BATCH_LANES] = {{0.}};
+      for (size_t p = 0; p < k; p++)
+      {
+        const double *a = A + (i * k + p) * BATCH_LANES;
+        for (size_t c = 0; c < BATCH_COLS; c++)
+        {
+          if (j + c < n)
+          {
+            const double *b = B + (p * n + j + c) * BATCH_LANES;
+            #pragma omp simd
+            for (size_t l = 0; l < BATCH_LANES; l++)
+              acc[c][l] += a[l] * b[l];
+          }
+        }
+      }
+      for (size_t c = 0; c < BATCH_COLS; c++)
+        if (j + c < n)
+          for (size_t l = 0; l < BATCH_LANES; l++)
+            C[(i * n + j + c) * BATCH_LANES + l] = acc[c][l];
+    }
+  }
+}
+
+// Generic kernel: sizes known at run time only
+BATCH_CLONES
+static void batch_gemm_generic(size_t m, size_t n, size_t k, size_t packs,
+                               const double *A, const double *B, double *C)
+{
+  #pragma omp parallel for schedule(static)
+  for (size_t q = 0; q < packs; q++)
+    batch_gemm_pack(m, n, k, A + q * m * k * BATCH_LANES, B + q * k * n * BATCH_LANES,
+                    C + q * m * n * BATCH_LANES);
+}
+
+// Specialized kernel for S x S matrices: constant sizes, the loops unroll
+#define BATCH_SPECIALIZE(S)                                                      \
+  BATCH_CLONES                                                                   \
+  static void batch_gemm_##S(size_t packs, const double *A, const double *B,     \
+                             double *C)                                          \
+  {                                                                              \
+    _Pragma("omp parallel for schedule(static)")                                 \
+    for (size_t q = 0; q < packs; q++)                                           \
+      batch_gemm_pack(S, S, S, A + q * S * S * BATCH_LANES,                      \
+                      B + q * S * S * BATCH_LANES, C + q * S * S * BATCH_LANES); \
+  }
+
+BATCH_SPECIALIZE(4)
+BATCH_SPECIALIZE(8)
+BATCH_SPECIALIZE(12)
+BATCH_SPECIALIZE(16)
+BATCH_SPECIALIZE(24)
+BATCH_SPECIALIZE(32)
+
+static const struct
+{
+  size_t size;
+  batch_kernel kernel;
+} batch_kernels[] = {
+  {4, batch_gemm_4}, {8, batch_gemm_8}, {12, batch_gemm_12},
+  {16, batch_gemm_16}, {24, batch_gemm_24}, {32, batch_gemm_32},
+};
+
+/**
+ * batch_gemm function:
+ * this function computes the count products C_b = A_b.B_b of interleaved
+ * batches (see batch_pack), in parallel over the packs. A specialized
+ * kernel is used when m = n = k is one of the sizes of batch_kernels.
+ */
+void batch_gemm(size_t m, size_t n, size_t k, size_t count, const double *A,
+                const double *B, double *C)
+{
+  size_t packs = (count + BATCH_LANES - 1) / BATCH_LANES;
+
+  if (m == n && n == k)
+  {
+    for (size_t s = 0; s < sizeof(batch_kernels) / sizeof(batch_kernels[0]); s++)
+    {
+      if (batch_kernels[s].size == m)
+      {
+        batch_kernels[s].kernel(packs, A, B, C);
+        return;
+      }
+    }
+  }
+  batch_gemm_generic(m, n, k, packs, A, B, C);
+}
+
+// Reference for batches: one naive product per matrix, parallel over matrices
+void batch_gemm_reference(size_t m, size_t n, size_t k, size_t count, const double *A,
+                          const double *B, double *C)
+{
+  #pragma omp parallel for schedule(static)
+  for (size_t b = 0; b < count; b++)
+  {
+    const double *Ab = A + b * m * k, *Bb = B + b * k * n;
+    double *Cb = C + b * m * n;
+    for (size_t i = 0; i < m; i++)
+      for (size_t j = 0; j < n; j++)
+      {
+        Cb[i * n + j] = 0.;
+        for (size_t p = 0; p < k; p++)
+          Cb[i * n + j] += Ab[i * k + p] * Bb[p * n + j];
+      }
+  }
+}
+
+/**
+ * batch_benchmark function:
+ * this function times the per-matrix reference and batch_gemm (layout
+ * conversion excluded) on count random size x size products and checks
+ * the results.
+ */
+void batch_benchmark(size_t size, size_t count)
+{
+  size_t elements = count * size * size, doubles = batch_doubles(size, size, count);
+  double *A = malloc(elements * sizeof(double));
+  double *B = malloc(elements * sizeof(double));
+  double *C = malloc(elements * sizeof(double));
+  double *ref = malloc(elements * sizeof(double));
+  double *Ai = aligned_alloc(64, doubles * sizeof(double));
+  double *Bi = aligned_alloc(64, doubles * sizeof(double));
+  double *Ci = aligned_alloc(64, doubles * sizeof(double));
+  double time_reference, time_batch, flops = 2. * size * size * size * count;
+
+  for (size_t i = 0; i < elements; i++)
+  {
+    A[i] = (double)rand() / (double)(RAND_MAX / MAX_VAL);
+    B[i] = (double)rand() / (double)(RAND_MAX / MAX_VAL);
+  }
+  batch_pack(size, size, count, A, Ai);
+  batch_pack(size, size, count, B, Bi);
+  memset(Ci, 0, doubles * sizeof(double));
+
+  printf("%zu products of %zux%zu matrices\n", count, size, size);
+  time_reference = omp_get_wtime();
+  batch_gemm_reference(size, size, size, count, A, B, ref);
+  time_reference = omp_get_wtime() - time_reference;
+  printf("Reference time : %3.5lf s (%.2lf GFLOP/s)\n", time_reference,
+         flops / time_reference * 1.e-9);
+
+  time_batch = omp_get_wtime();
+  batch_gemm(size, size, size, count, Ai, Bi, Ci);
+  time_batch = omp_get_wtime() - time_batch;
+  printf("Batch time --- : %3.5lf s (%.2lf GFLOP/s, speedup %3.5lf)\n", time_batch,
+         flops / time_batch * 1.e-9, time_reference / time_batch);
+
+  batch_unpack(size, size, count, Ci, C);
+  for (size_t i = 0; i < elements; i++)
+  {
+    if (fabs(ref[i] - C[i]) > REL_ERROR * fabs(ref[i]))
+    {
+      printf("Bad batch results :-(((\n");
+      exit(1);
+    }
+  }
+  printf("OK batch results :-)\n");
+
+  free(A);
+  free(B);
+  free(C);
+  free(ref);
+  free(Ai);
+  free(Bi);
+  free(Ci);
+}
+
+#ifdef USE_MPI
+/**
+ * SUMMA (MPI build, compile with mpicc -DUSE_MPI):
+ * C = A.B on a P x Q grid of MPI ranks. The N x N matrices are distributed
+ * block-cyclically by SUMMA_NB x SUMMA_NB blocks: global block (I, J) is
+ * owned by rank (I % P, J % Q), which stores it at local block
+ * (I / P, J / Q) of a row-major local matrix. At step K, the ranks of the
+ * grid column K % Q broadcast their part of the block column K of A along
+ * their grid row, the ranks of the grid row K % P broadcast their part of
+ * the block row K of B along their grid column, then every rank
+ * accumulates the product of the two panels into its local C (gemm_update,
+ * with packing buffers allocated once for all the steps).
+ * Broadcasts are non-blocking and double buffered: the panels of step
+ * K + 1 are in flight while step K is computed (how much actually
+ * overlaps depends on the progress engine of the MPI library).
+ */
+#define SUMMA_NB 64 // Default distribution block size
+
+// Number of rows (or columns) of n owned by grid coordinate coord out of procs
+static size_t summa_local_size(size_t n, size_t nb, int procs, int coord)
+{
+  size_t size = 0;
+  for (size_t b = (size_t)coord; b * nb < n; b += (size_t)procs)
+    size += min(nb, n - b * nb);
+  return size;
+}
+
+// Global index of local index l for grid coordinate coord out of procs
+static size_t summa_global_index(size_t l, size_t nb, int procs, int coord)
+{
+  return ((l / nb) * (size_t)procs + (size_t)coord) * nb + l % nb;
+}
+
+// Copies the local part of rank (pr, pc) between the N x N matrix M and local
+static void summa_copy(size_t nb, int P, int Q, int pr, int pc, double *M,
+                       double *local, int to_local)
+{
+  size_t rows = summa_local_size(N, nb, P, pr), cols = summa_local_size(N, nb, Q, pc);
+
+  for (size_t li = 0; li < rows; li++)
+  {
+    double *row = M + summa_global_index(li, nb, P, pr) * N;
+    for (size_t lj = 0; lj < cols; lj++)
+    {
+      size_t j = summa_global_index(lj, nb, Q, pc);
+      if (to_local)
+        local[li * cols + lj] = row[j];
+      else
+        row[j] = local[li * cols + lj];
+    }
+  }
+}
+
+/**
+ * summa_main function:
+ * main of the MPI build: rank 0 initializes A and B, computes the
+ * reference, scatters A and B, every rank runs SUMMA, then rank 0 gathers
+ * C, checks it and prints the times (maximum over ranks).
+ * Usage: mpirun -np K tp2_1_matmat [block size]
+ */
+int summa_main(int argc, char *argv[])
+{
+  int rank, size, dims[2] = {0, 0}, P, Q, pr, pc;
+  size_t nb = SUMMA_NB;
+  double *A = NULL, *B = NULL, *C = NULL, *ref = NULL;
+  double time_reference = 0., time_summa, time_compute = 0., time_comm = 0., t;
+  double flops = 2. * N * N * N;
+  MPI_Comm row_comm, col_comm;
+
+  MPI_Init(&argc, &argv);
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &size);
+  if (argc > 1 && atol(argv[1]) > 0)
+    nb = (size_t)atol(argv[1]);
+  MPI_Dims_create(size, 2, dims);
+  P = dims[0];
+  Q = dims[1];
+  pr = rank / Q;
+  pc = rank % Q;
+  MPI_Comm_split(MPI_COMM_WORLD, pr, pc, &row_comm); // Rank pc in its grid row
+  MPI_Comm_split(MPI_COMM_WORLD, pc, pr, &col_comm); // Rank pr in its grid column
+  gemm_init();
+
+  size_t rows = summa_local_size(N, nb, P, pr), cols = summa_local_size(N, nb, Q, pc);
+  size_t kblocks = (N + nb - 1) / nb;
+  double *Al = malloc((rows * cols + 1) * sizeof(double));
+  double *Bl = malloc((rows * cols + 1) * sizeof(double));
+  double *Cl = calloc(rows * cols + 1, sizeof(double));
+  double *Apanel[2], *Bpanel[2];
+  double *buffer = aligned_alloc(64, gemm_buffer_size() * sizeof(double)); // Packing
+  MPI_Request requests[2][2];
+  for (int s = 0; s < 2; s++)
+  {
+    Apanel[s] = malloc((rows * nb + 1) * sizeof(double));
+    Bpanel[s] = malloc((nb * cols + 1) * sizeof(double));
+  }
+
+  // Initialization and reference on rank 0, then scatter of the local parts
+  if (rank == 0)
+  {
+    A = malloc(N * N * sizeof(double));
+    B = malloc(N * N * sizeof(double));
+    C = malloc(N * N * sizeof(double));
+    ref = malloc(N * N * sizeof(double));
+    srand((unsigned int)time(NULL));
+    for (size_t i = 0; i < N * N; i++)
+    {
+      A[i] = (double)rand() / (double)(RAND_MAX / MAX_VAL);
+      B[i] = (double)rand() / (double)(RAND_MAX / MAX_VAL);
+    }
+    time_reference = omp_get_wtime();
+    matmat_reference((double(*)[N])ref, (double(*)[N])A, (double(*)[N])B);
+    time_reference = omp_get_wtime() - time_reference;
+    printf("Grid %d x %d, block %zu, %d thread(s) per rank\n", P, Q, nb,
+           omp_get_max_threads());
+    printf("Reference time : %3.5lf s\n", time_reference);
+
+    for (int r = size - 1; r >= 0; r--)
+    {
+      int rr = r / Q, rc = r % Q;
+      size_t count = summa_local_size(N, nb, P, rr) * summa_local_size(N, nb, Q, rc);
+      summa_copy(nb, P, Q, rr, rc, A, Al, 1);
+      summa_copy(nb, P, Q, rr, rc, B, Bl, 1);
+      if (r != 0)
+      {
+        MPI_Send(Al, (int)count, MPI_DOUBLE, r, 0, MPI_COMM_WORLD);
+        MPI_Send(Bl, (int)count, MPI_DOUBLE, r, 1, MPI_COMM_WORLD);
+      }
+    }
+  }
+  else
+  {
+    MPI_Recv(Al, (int)(rows * cols), MPI_DOUBLE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    MPI_Recv(Bl, (int)(rows * cols), MPI_DOUBLE, 0, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+  }
+
+  MPI_Barrier(MPI_COMM_WORLD);
+  time_summa = omp_get_wtime();
+  for (size_t K = 0; K <= kblocks; K++)
+  {
+    // Post the broadcasts of step K (one step ahead of the computation)
+    if (K < kblocks)
+    {
+      int s = K % 2, root_col = (int)(K % Q), root_row = (int)(K % P);
+      size_t kb = min(nb, N - K * nb);
+      t = omp_get_wtime();
+      if (pc == root_col)
+      {
+        size_t lk = (K / Q) * nb; // First local column of the block column
+        for (size_t i = 0; i < rows; i++)
+          memcpy(Apanel[s] + i * kb, Al + i * cols + lk, kb * sizeof(double));
+      }
+      if (pr == root_row)
+      {
+        size_t lk = (K / P) * nb; // First local row of the block row
+        memcpy(Bpanel[s], Bl + lk * cols, kb * cols * sizeof(double));
+      }
+      MPI_Ibcast(Apanel[s], (int)(rows * kb), MPI_DOUBLE, root_col, row_comm,
+                 &requests[s][0]);
+      MPI_Ibcast(Bpanel[s], (int)(kb * cols), MPI_DOUBLE, root_row, col_comm,
+                 &requests[s][1]);
+      time_comm += omp_get_wtime() - t;
+    }
+
+    // Compute step K - 1 while step K is in flight
+    if (K > 0)
+    {
+      int s = (K - 1) % 2;
+      size_t kb = min(nb, N - (K - 1) * nb);
+      t = omp_get_wtime();
+      MPI_Waitall(2, requests[s], MPI_STATUSES_IGNORE);
+      time_comm += omp_get_wtime() - t;
+
+      t = omp_get_wtime();
+      gemm_update(rows, cols, kb, Apanel[s], kb, Bpanel[s], cols, Cl, cols, buffer);
+      time_compute += omp_get_wtime() - t;
+    }
+  }
+  time_summa = omp_get_wtime() - time_summa;
+
+  double local_times[3] = {time_summa, time_compute, time_comm}, times[3];
+  MPI_Reduce(local_times, times, 3, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+  // Gather of C on rank 0 and check
+  if (rank == 0)
+  {
+    summa_copy(nb, P, Q, 0, 0, C, Cl, 0);
+    for (int r = 1; r < size; r++)
+    {
+      int rr = r / Q, rc = r % Q;
+      size_t count = summa_local_size(N, nb, P, rr) * summa_local_size(N, nb, Q, rc);
+      MPI_Recv(Al, (int)count, MPI_DOUBLE, r, 2, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+      summa_copy(nb, P, Q, rr, rc, C, Al, 0);
+    }
+
+    double speedup = time_reference / times[0];
+    printf("SUMMA time --- : %3.5lf s (%.2lf GFLOP/s)\n", times[0], flops / times[0] * 1.e-9);
+    printf("Compute time - : %3.5lf s (max over ranks)\n", times[1]);
+    printf("Comm time ---- : %3.5lf s (max over ranks, panel copies + waits)\n", times[2]);
+    printf("Speedup ------ : %3.5lf\n", speedup);
+    printf("Efficiency --- : %3.5lf\n", speedup / size);
+    for (size_t i = 0; i < N * N; i++)
+    {
+      if (fabs(ref[i] - C[i]) > REL_ERROR * fabs(ref[i]))
+      {
+        printf("Bad SUMMA results :-(((\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+      }
+    }
+    printf("OK SUMMA results :-)\n");
+    free(A);
+    free(B);
+    free(C);
+    free(ref);
+  }
+  else
+    MPI_Send(Cl, (int)(rows * cols), MPI_DOUBLE, 0, 2, MPI_COMM_WORLD);
+
+  for (int s = 0; s < 2; s++)
+  {
+    free(Apanel[s]);
+    free(Bpanel[s]);
+  }
+  free(Al);
+  free(Bl);
+  free(Cl);
+  free(buffer);
+  MPI_Comm_free(&row_comm);
+  MPI_Comm_free(&col_comm);
+  MPI_Finalize();
+  return 0;
+}
+#endif
+
+int main(int argc, char *argv[])
+{
+#ifdef USE_MPI
+  return summa_main(argc, argv);
+#endif
+  double time_reference, time_kernel, speedup, efficiency;
+  double time_gemm, flops = 2. * N * N * N;
+
+  gemm_init();
+
+  // Strassen mode: tp2_1_matmat strassen [size] [cutoff]
+  if (argc > 1 && strcmp(argv[1], "strassen") == 0)
+  {
+    srand((unsigned int)time(NULL));
+    long cutoff = (argc > 3) ? atol(argv[3]) : STRASSEN_CUTOFF;
+    if (cutoff < STRASSEN_MIN_CUTOFF)
+    {
+      fprintf(stderr, "usage: %s strassen [size] [cutoff >= %d]\n", argv[0],
+              STRASSEN_MIN_CUTOFF);
+      return 1;
+    }
+    strassen_benchmark((argc > 2) ? (size_t)atol(argv[2]) : STRASSEN_N, (size_t)cutoff);
+    return 0;
+  }
+
+  // Batch mode: tp2_1_matmat batch [size] [count]
+  if (argc > 1 && strcmp(argv[1], "batch") == 0)
+  {
+    size_t size = (argc > 2) ? (size_t)atol(argv[2]) : BATCH_SIZE;
+    srand((unsigned int)time(NULL));
+    batch_benchmark(size, (argc > 3) ? (size_t)atol(argv[3]) : BATCH_ELEMENTS / (size * size));
+    return 0;
+  }
+
   double *A = malloc(N * N * sizeof(double));
   double *B = malloc(N * N * sizeof(double));
   double *C = malloc(N * N * sizeof(double));
   double *ref = malloc(N * N * sizeof(double));
-  double time_reference, time_kernel, speedup, efficiency;
 
   // Initialization by random values
   srand((unsigned int)time(NULL));
@@ -89,6 +1171,24 @@ int main()
   }
   printf("OK results :-)\n");
 
+  // Packed, register-tiled GEMM
+  time_gemm = omp_get_wtime();
+  gemm(N, N, N, A, N, B, N, C, N);
+  time_gemm = omp_get_wtime() - time_gemm;
+  printf("GEMM time (%s) : %3.5lf s\n", gemm_isa, time_gemm);
+  printf("GFLOP/s ------ : reference %.2lf, kernel %.2lf, GEMM %.2lf\n",
+         flops / time_reference * 1.e-9, flops / time_kernel * 1.e-9,
+         flops / time_gemm * 1.e-9);
+  for (size_t i = 0; i < N * N; i++)
+  {
+    if (fabs(ref[i] - C[i]) > REL_ERROR * fabs(ref[i]))
+    {
+      printf("Bad GEMM results :-(((\n");
+      exit(1);
+    }
+  }
+  printf("OK GEMM results :-)\n");
+
   free(A);
   free(B);
   free(C);
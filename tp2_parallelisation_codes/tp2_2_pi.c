@@ -1,8 +1,16 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 #include <time.h>
 #include <math.h>
+#include <float.h>
 #include <omp.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86 1
+#endif
+#define min(x, y) ((x) < (y) ? (x) : (y))
 #define PI             "3.141592653589793238462"
 #define HYPERTHREADING 1      // 1 if hyperthreading is on, 0 otherwise
 #define ERROR          1.e-10 // Acceptable precision
@@ -42,9 +50,557 @@ void pi_kernel(size_t nb_steps, double* pi) {
   *pi = step * sum;
 }
 
-int main() {
+/**
+ * pi_simd_* functions:
+ * these functions return 4 times the sum of 1 / (1 + x^2) for the
+ * midpoints x = (i + 0.5) step, i in [lo, hi). The vector variants avoid
+ * the division (one vdivpd every few cycles at best): an approximate
+ * reciprocal (rcp14 with AVX-512, single precision rcp with AVX2) is
+ * refined by Newton-Raphson r = r (2 - d r), each step doubles the number
+ * of correct bits (14 -> 28 -> 56, 12 -> 24 -> 48), enough for ERROR.
+ * x is strength-reduced (one addition per vector instead of a conversion
+ * and a multiplication) and recomputed exactly every PI_BLOCK points so
+ * that the rounding errors of the additions do not accumulate. Four
+ * independent accumulators hide the latency of the additions. Each
+ * variant is compiled for its own instruction set and pi_simd_init
+ * selects the best one the CPU supports.
+ */
+#define PI_BLOCK 4096 // Points between two exact computations of x (multiple of 32)
+
+static double pi_simd_scalar(size_t lo, size_t hi, double step) {
+  double acc0 = 0., acc1 = 0., acc2 = 0., acc3 = 0.;
+  size_t i;
+
+  for (i = lo; i + 4 <= hi; i += 4) {
+    double x = (i + 0.5) * step;
+    acc0 += 1. / (1. + x * x);
+    x = (i + 1.5) * step;
+    acc1 += 1. / (1. + x * x);
+    x = (i + 2.5) * step;
+    acc2 += 1. / (1. + x * x);
+    x = (i + 3.5) * step;
+    acc3 += 1. / (1. + x * x);
+  }
+  for (; i < hi; i++) {
+    double x = (i + 0.5) * step;
+    acc0 += 1. / (1. + x * x);
+  }
+  return 4. * ((acc0 + acc1) + (acc2 + acc3));
+}
+
+#ifdef SIMD_X86
+// 1 / (1 + x^2) with a 12-bit single precision reciprocal and 2 Newton steps
+__attribute__((target("avx2,fma")))
+static inline __m256d pi_term_avx2(__m256d x) {
+  const __m256d one = _mm256_set1_pd(1.), two = _mm256_set1_pd(2.);
+  __m256d d = _mm256_fmadd_pd(x, x, one);
+  __m256d r = _mm256_cvtps_pd(_mm_rcp_ps(_mm256_cvtpd_ps(d)));
+  r = _mm256_mul_pd(r, _mm256_fnmadd_pd(d, r, two));
+  return _mm256_mul_pd(r, _mm256_fnmadd_pd(d, r, two));
+}
+
+__attribute__((target("avx2,fma")))
+static double pi_simd_avx2(size_t lo, size_t hi, double step) {
+  const __m256d offsets = _mm256_set_pd(3.5, 2.5, 1.5, 0.5);
+  const __m256d vstep = _mm256_set1_pd(step), inc = _mm256_set1_pd(16. * step);
+  __m256d acc0 = _mm256_setzero_pd(), acc1 = _mm256_setzero_pd();
+  __m256d acc2 = _mm256_setzero_pd(), acc3 = _mm256_setzero_pd();
+  size_t i = lo;
+
+  while (i + 16 <= hi) {
+    size_t end = i + min(PI_BLOCK, (hi - i) / 16 * 16);
+    __m256d x0 = _mm256_mul_pd(_mm256_add_pd(_mm256_set1_pd((double)i), offsets), vstep);
+    __m256d x1 = _mm256_add_pd(x0, _mm256_set1_pd(4. * step));
+    __m256d x2 = _mm256_add_pd(x0, _mm256_set1_pd(8. * step));
+    __m256d x3 = _mm256_add_pd(x0, _mm256_set1_pd(12. * step));
+    for (; i < end; i += 16) {
+      acc0 = _mm256_add_pd(acc0, pi_term_avx2(x0));
+      acc1 = _mm256_add_pd(acc1, pi_term_avx2(x1));
+      acc2 = _mm256_add_pd(acc2, pi_term_avx2(x2));
+      acc3 = _mm256_add_pd(acc3, pi_term_avx2(x3));
+      x0 = _mm256_add_pd(x0, inc);
+      x1 = _mm256_add_pd(x1, inc);
+      x2 = _mm256_add_pd(x2, inc);
+      x3 = _mm256_add_pd(x3, inc);
+    }
+  }
+  acc0 = _mm256_add_pd(_mm256_add_pd(acc0, acc1), _mm256_add_pd(acc2, acc3));
+  __m128d half = _mm_add_pd(_mm256_castpd256_pd128(acc0), _mm256_extractf128_pd(acc0, 1));
+  double sum = _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+  for (; i < hi; i++) {
+    double x = (i + 0.5) * step;
+    sum += 1. / (1. + x * x);
+  }
+  return 4. * sum;
+}
+
+// 1 / (1 + x^2) with a 14-bit reciprocal and 2 Newton steps
+__attribute__((target("avx512f")))
+static inline __m512d pi_term_avx512(__m512d x) {
+  const __m512d one = _mm512_set1_pd(1.), two = _mm512_set1_pd(2.);
+  __m512d d = _mm512_fmadd_pd(x, x, one);
+  __m512d r = _mm512_rcp14_pd(d);
+  r = _mm512_mul_pd(r, _mm512_fnmadd_pd(d, r, two));
+  return _mm512_mul_pd(r, _mm512_fnmadd_pd(d, r, two));
+}
+
+__attribute__((target("avx512f")))
+static double pi_simd_avx512(size_t lo, size_t hi, double step) {
+  const __m512d offsets = _mm512_set_pd(7.5, 6.5, 5.5, 4.5, 3.5, 2.5, 1.5, 0.5);
+  const __m512d vstep = _mm512_set1_pd(step), inc = _mm512_set1_pd(32. * step);
+  __m512d acc0 = _mm512_setzero_pd(), acc1 = _mm512_setzero_pd();
+  __m512d acc2 = _mm512_setzero_pd(), acc3 = _mm512_setzero_pd();
+  size_t i = lo;
+
+  while (i + 32 <= hi) {
+    size_t end = i + min(PI_BLOCK, (hi - i) / 32 * 32);
+    __m512d x0 = _mm512_mul_pd(_mm512_add_pd(_mm512_set1_pd((double)i), offsets), vstep);
+    __m512d x1 = _mm512_add_pd(x0, _mm512_set1_pd(8. * step));
+    __m512d x2 = _mm512_add_pd(x0, _mm512_set1_pd(16. * step));
+    __m512d x3 = _mm512_add_pd(x0, _mm512_set1_pd(24. * step));
+    for (; i < end; i += 32) {
+      acc0 = _mm512_add_pd(acc0, pi_term_avx512(x0));
+      acc1 = _mm512_add_pd(acc1, pi_term_avx512(x1));
+      acc2 = _mm512_add_pd(acc2, pi_term_avx512(x2));
+      acc3 = _mm512_add_pd(acc3, pi_term_avx512(x3));
+      x0 = _mm512_add_pd(x0, inc);
+      x1 = _mm512_add_pd(x1, inc);
+      x2 = _mm512_add_pd(x2, inc);
+      x3 = _mm512_add_pd(x3, inc);
+    }
+  }
+  acc0 = _mm512_add_pd(_mm512_add_pd(acc0, acc1), _mm512_add_pd(acc2, acc3));
+  double sum = _mm512_reduce_add_pd(acc0);
+  for (; i < hi; i++) {
+    double x = (i + 0.5) * step;
+    sum += 1. / (1. + x * x);
+  }
+  return 4. * sum;
+}
+#endif
+
+static double (*pi_simd)(size_t lo, size_t hi, double step) = pi_simd_scalar;
+static const char* pi_simd_isa = "scalar";
+
+// Selects the best pi_simd_* variant for the running CPU (CPUID)
+void pi_simd_init(void) {
+#ifdef SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    pi_simd = pi_simd_avx512;
+    pi_simd_isa = "avx512";
+  } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+    pi_simd = pi_simd_avx2;
+    pi_simd_isa = "avx2";
+  }
+#endif
+}
+
+/**
+ * pi_simd_kernel function:
+ * same computation as pi_kernel, each thread summing its contiguous slice
+ * of the steps with the selected SIMD variant.
+ */
+void pi_simd_kernel(size_t nb_steps, double* pi) {
+  double sum = 0.;
+  double step = 1./(double)nb_steps;
+
+  #pragma omp parallel reduction(+:sum)
+  {
+    size_t nb_threads = omp_get_num_threads();
+    size_t tid = omp_get_thread_num();
+    sum += pi_simd(nb_steps * tid / nb_threads, nb_steps * (tid + 1) / nb_threads, step);
+  }
+
+  *pi = step * sum;
+}
+
+/**
+ * Adaptive integration:
+ * integral of a user integrand f(x, data) over [a, b] with the 15-point
+ * Gauss-Kronrod rule. On each interval the 7-point Gauss rule (nodes
+ * shared with Kronrod, no extra evaluation) gives the error estimate
+ * |K15 - G7|. An interval whose estimate is above its share of the
+ * tolerance (proportional to its length) is split in two halves, the
+ * halves are integrated by OpenMP tasks down to INTEGRATE_TASK_DEPTH,
+ * sequentially below. The work adapts to the integrand: smooth parts
+ * are covered by a few wide intervals, difficult parts get refined.
+ * An interval whose estimate is at the rounding level of its value is not
+ * split either: halves would not be more accurate (tolerances below the
+ * double precision of the result).
+ */
+#define INTEGRATE_TASK_DEPTH 10 // Subdivision levels creating tasks
+#define INTEGRATE_MAX_DEPTH  40 // Subdivision levels before giving up on an interval
+#define INTEGRATE_ROUNDING   (4. * DBL_EPSILON) // Relative error at rounding level
+
+typedef double (*integrand)(double x, void* data);
+
+typedef struct {
+  double value;       // Estimate of the integral
+  double error;       // Sum of the error estimates of the accepted intervals
+  size_t evaluations; // Number of calls to the integrand
+  size_t intervals;   // Number of accepted intervals
+} integral;
+
+// Kronrod nodes (positive half, x_gk[7] = 0) and weights, Gauss weights
+static const double x_gk[8] = {
+  0.991455371120812639206854697526329, 0.949107912342758524526189684047851,
+  0.864864423359769072789712788640926, 0.741531185599394439863864773280788,
+  0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+  0.207784955007898467600689403773245, 0.000000000000000000000000000000000
+};
+static const double w_gk[8] = {
+  0.022935322010529224963732008058970, 0.063092092629978553290700663189204,
+  0.104790010322250183839876322541518, 0.140653259715525918745189590510238,
+  0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+  0.204432940075298892414161999234649, 0.209482141084727828012999174891714
+};
+static const double w_g[4] = { // Gauss weights of x_gk[1], x_gk[3], x_gk[5], x_gk[7]
+  0.129484966168869693270611432679082, 0.279705391489276667901467771423780,
+  0.381830050505118944950369775488975, 0.417959183673469387755102040816327
+};
+
+// 15-point Gauss-Kronrod rule on [a, b]
+static integral gauss_kronrod(integrand f, void* data, double a, double b) {
+  double center = 0.5 * (a + b), half = 0.5 * (b - a);
+  double fc = f(center, data);
+  double kronrod = w_gk[7] * fc, gauss = w_g[3] * fc;
+
+  for (int j = 0; j < 7; j++) {
+    double dx = half * x_gk[j];
+    double fsum = f(center - dx, data) + f(center + dx, data);
+    kronrod += w_gk[j] * fsum;
+    if (j % 2 == 1)
+      gauss += w_g[j / 2] * fsum;
+  }
+
+  integral r = { kronrod * half, fabs((kronrod - gauss) * half), 15, 1 };
+  return r;
+}
+
+static integral integrate_rec(integrand f, void* data, double a, double b,
+                              double tol, int depth) {
+  integral r = gauss_kronrod(f, data, a, b);
+  double m = 0.5 * (a + b);
+
+  if (r.error <= tol || r.error <= INTEGRATE_ROUNDING * fabs(r.value) ||
+      depth >= INTEGRATE_MAX_DEPTH || m <= a || m >= b)
+    return r;
+
+  integral left, right;
+  #pragma omp task shared(left) if (depth < INTEGRATE_TASK_DEPTH)
+  left = integrate_rec(f, data, a, m, 0.5 * tol, depth + 1);
+  #pragma omp task shared(right) if (depth < INTEGRATE_TASK_DEPTH)
+  right = integrate_rec(f, data, m, b, 0.5 * tol, depth + 1);
+  #pragma omp taskwait
+
+  r.value = left.value + right.value;
+  r.error = left.error + right.error;
+  r.evaluations += left.evaluations + right.evaluations;
+  r.intervals = left.intervals + right.intervals;
+  return r;
+}
+
+/**
+ * integrate function:
+ * this function returns the integral of f over [a, b], refined until the
+ * estimated absolute error is below tol (or the subdivision limit is
+ * reached, then the returned error is above tol).
+ * \param data is passed to every call of f (parameters of the integrand)
+ */
+integral integrate(integrand f, void* data, double a, double b, double tol) {
+  integral r;
+
+  #pragma omp parallel
+  #pragma omp single
+  r = integrate_rec(f, data, a, b, tol, 0);
+  return r;
+}
+
+// Integrands of the "integrate" mode
+static double f_pi(double x, void* data) {
+  (void)data;
+  return 4. / (1. + x * x);
+}
+
+static double f_gauss(double x, void* data) {
+  (void)data;
+  return exp(-x * x);
+}
+
+static double f_sqrt(double x, void* data) {
+  (void)data;
+  return sqrt(x);
+}
+
+static double f_cos(double x, void* data) {
+  return 1. + cos(*(double*)data * x);
+}
+
+/**
+ * integrate_benchmark function:
+ * this function integrates a few integrands over [0, 1] with the adaptive
+ * engine and prints the number of evaluations needed to reach tol,
+ * compared to the N evaluations of pi_kernel. Each result must be within
+ * tol of the exact value, or within its error estimate when tol cannot be
+ * reached (maximum depth), up to the rounding of the result.
+ */
+void integrate_benchmark(double tol) {
+  double frequency = 50.;
+  struct {
+    const char* name;
+    integrand f;
+    void* data;
+    double exact;
+  } tests[] = {
+    { "4/(1+x^2)  ", f_pi,    NULL,       atof(PI) },
+    { "exp(-x^2)  ", f_gauss, NULL,       0.5 * sqrt(atof(PI)) * erf(1.) },
+    { "sqrt(x)    ", f_sqrt,  NULL,       2. / 3. },
+    { "1+cos(50x) ", f_cos,   &frequency, 1. + sin(50.) / 50. },
+  };
+  int ok = 1;
+
+  printf("Tolerance %.1le, pi_kernel uses %d evaluations\n", tol, N);
+  for (size_t t = 0; t < sizeof(tests) / sizeof(tests[0]); t++) {
+    double time = omp_get_wtime();
+    integral r = integrate(tests[t].f, tests[t].data, 0., 1., tol);
+    time = omp_get_wtime() - time;
+    double error = fabs(r.value - tests[t].exact);
+    printf("%s: %.17g (error %.2le, estimate %.2le) %8zu evaluations, %6zu intervals, %3.5lf s\n",
+           tests[t].name, r.value, error, r.error, r.evaluations, r.intervals, time);
+    // Within the requested or the reported error, up to the rounding of the result
+    if (!(error <= fmax(tol, r.error) + INTEGRATE_ROUNDING * fabs(tests[t].exact)))
+      ok = 0;
+  }
+  if (!ok) {
+    printf("Bad integration results :-(((\n");
+    exit(1);
+  }
+  printf("OK integration results :-)\n");
+}
+
+/**
+ * Monte Carlo integration:
+ * mean of f over samples points drawn uniformly in [0, 1]^dim. Random
+ * numbers come from the counter-based generator Philox4x32-10: the i-th
+ * output is a pure function of (counter, key) = ((i, word), seed), there
+ * is no generator state to share, split or skip ahead. Sample i uses
+ * counters (i, 0), (i, 1)... (2 coordinates per counter), so every thread
+ * can generate any sample independently. Samples are processed by blocks
+ * of MC_BLOCK whose partial sums are stored and added in block order: the
+ * result is the same bits for any number of threads. Within a block,
+ * MC_LANES samples are generated and evaluated together (SIMD loops over
+ * the lanes, integrands receive a batch of points).
+ */
+#define MC_LANES    16       // Samples generated and evaluated together
+#define MC_BLOCK    65536    // Samples per block (multiple of MC_LANES)
+#define MC_MAX_DIM  64       // Maximum dimension of the integration domain
+#define MC_SAMPLES  67108864 // Default number of samples of the "mc" mode
+#define MC_SIGMAS   5.       // Acceptable error in standard errors
+#define PHILOX_M0   0xD2511F53ull // Philox4x32 multipliers
+#define PHILOX_M1   0xCD9E8D57ull
+#define PHILOX_W0   0x9E3779B9ull // Philox4x32 key increments (Weyl sequence)
+#define PHILOX_W1   0xBB67AE85ull
+
+#ifdef SIMD_X86
+#define MC_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define MC_CLONES
+#endif
+
+// Integrand on a batch: f[l] = f(x[0][l], ..., x[dim - 1][l]) for every lane l
+typedef void (*mc_integrand)(int dim, double x[][MC_LANES], double f[MC_LANES], void* data);
+
+/**
+ * philox_uniform function:
+ * this function fills x[2 word][l] and x[2 word + 1][l] with the 2 uniform
+ * doubles in [0, 1) (52 random bits each) given by Philox4x32-10 for the
+ * counter (first + l, word) and the key seed, for every lane l.
+ */
+static inline void philox_uniform(uint64_t first, uint32_t word, uint64_t seed,
+                                  double x[][MC_LANES]) {
+  #pragma omp simd
+  for (int l = 0; l < MC_LANES; l++) {
+    // 32-bit words kept in 64-bit lanes: the 32 x 32 -> 64 products map to
+    // a single vpmuludq per vector, without packing and unpacking
+    const uint64_t mask = 0xFFFFFFFFull;
+    uint64_t n = first + l;
+    uint64_t c0 = n & mask, c1 = n >> 32, c2 = word, c3 = 0;
+    uint64_t k0 = seed & mask, k1 = seed >> 32;
+    for (int r = 0; r < 10; r++) {
+      uint64_t p0 = PHILOX_M0 * c0, p1 = PHILOX_M1 * c2;
+      c0 = (p1 >> 32) ^ c1 ^ k0;
+      c1 = p1 & mask;
+      c2 = (p0 >> 32) ^ c3 ^ k1;
+      c3 = p0 & mask;
+      k0 = (k0 + PHILOX_W0) & mask;
+      k1 = (k1 + PHILOX_W1) & mask;
+    }
+    // 52 random bits as the mantissa of a double in [1, 2) (no int -> double
+    // conversion, which has no vector instruction before AVX-512DQ)
+    uint64_t u0 = 0x3FF0000000000000ull | (((c0 << 32) | c1) >> 12);
+    uint64_t u1 = 0x3FF0000000000000ull | (((c2 << 32) | c3) >> 12);
+    double d0, d1;
+    memcpy(&d0, &u0, sizeof(double));
+    memcpy(&d1, &u1, sizeof(double));
+    x[2 * word][l] = d0 - 1.;
+    x[2 * word + 1][l] = d1 - 1.;
+  }
+}
+
+// Sum and sum of squares of f over samples [first, first + count) of a block
+MC_CLONES
+static void monte_carlo_block(mc_integrand f, void* data, int dim, uint64_t seed,
+                              uint64_t first, size_t count, double sums[2]) {
+  double x[MC_MAX_DIM + 1][MC_LANES], values[MC_LANES];
+  double sum[MC_LANES] = {0.}, sum2[MC_LANES] = {0.};
+
+  for (size_t s = 0; s < count; s += MC_LANES) {
+    for (int word = 0; 2 * word < dim; word++)
+      philox_uniform(first + s, (uint32_t)word, seed, x);
+    f(dim, x, values, data);
+    #pragma omp simd
+    for (int l = 0; l < MC_LANES; l++) {
+      double v = (s + l < count) ? values[l] : 0.;
+      sum[l] += v;
+      sum2[l] += v * v;
+    }
+  }
+  sums[0] = sums[1] = 0.;
+  for (int l = 0; l < MC_LANES; l++) {
+    sums[0] += sum[l];
+    sums[1] += sum2[l];
+  }
+}
+
+/**
+ * monte_carlo function:
+ * this function returns the Monte Carlo estimate of the integral of f over
+ * [0, 1]^dim with samples points of the stream seed, and its standard
+ * error in *std_error. The result only depends on (f, dim, samples, seed).
+ * Both are NaN if dim is not in [1, MC_MAX_DIM] or samples is 0.
+ */
+double monte_carlo(mc_integrand f, void* data, int dim, size_t samples, uint64_t seed,
+                   double* std_error) {
+  if (dim < 1 || dim > MC_MAX_DIM || samples == 0) {
+    *std_error = NAN;
+    return NAN;
+  }
+
+  size_t nb_blocks = (samples + MC_BLOCK - 1) / MC_BLOCK;
+  double (*partial)[2] = malloc(nb_blocks * sizeof(*partial));
+  double sum = 0., sum2 = 0.;
+
+  #pragma omp parallel for schedule(static)
+  for (size_t b = 0; b < nb_blocks; b++)
+    monte_carlo_block(f, data, dim, seed, (uint64_t)b * MC_BLOCK,
+                      min(MC_BLOCK, samples - b * MC_BLOCK), partial[b]);
+
+  for (size_t b = 0; b < nb_blocks; b++) {
+    sum += partial[b][0];
+    sum2 += partial[b][1];
+  }
+  free(partial);
+
+  double mean = sum / samples;
+  *std_error = sqrt(fmax(sum2 / samples - mean * mean, 0.) / samples);
+  return mean;
+}
+
+// 4 inside the quarter disc, 0 outside: the mean is pi
+static void mc_quarter_disc(int dim, double x[][MC_LANES], double f[MC_LANES], void* data) {
+  (void)dim;
+  (void)data;
+  #pragma omp simd
+  for (int l = 0; l < MC_LANES; l++)
+    f[l] = (x[0][l] * x[0][l] + x[1][l] * x[1][l] <= 1.) ? 4. : 0.;
+}
+
+// Product of pi/2 sin(pi x_k) over the dimensions: the integral is 1
+static void mc_sine_product(int dim, double x[][MC_LANES], double f[MC_LANES], void* data) {
+  double pi = *(double*)data;
+  #pragma omp simd
+  for (int l = 0; l < MC_LANES; l++)
+    f[l] = 1.;
+  for (int k = 0; k < dim; k++) {
+    #pragma omp simd
+    for (int l = 0; l < MC_LANES; l++)
+      f[l] *= 0.5 * pi * sin(pi * x[k][l]);
+  }
+}
+
+/**
+ * monte_carlo_benchmark function:
+ * this function estimates pi (dimension 2) and a dimension 8 integral
+ * with 1 thread then every thread, checks that both runs give the same
+ * bits and that the estimates are within MC_SIGMAS standard errors, and
+ * prints the throughput next to the one of pi_kernel.
+ */
+void monte_carlo_benchmark(size_t samples, uint64_t seed) {
+  double pi = atof(PI), pi_quad, time;
+  int max_threads = omp_get_max_threads(), ok = 1;
+  struct {
+    const char* name;
+    mc_integrand f;
+    int dim;
+    double exact;
+  } tests[] = {
+    { "pi, dim 2      ", mc_quarter_disc, 2, pi },
+    { "sin prod, dim 8", mc_sine_product, 8, 1. },
+  };
+
+  time = omp_get_wtime();
+  pi_kernel(N, &pi_quad);
+  time = omp_get_wtime() - time;
+  printf("pi_kernel ---- : %.3le points/s (%d threads)\n", N / time, max_threads);
+
+  for (size_t t = 0; t < sizeof(tests) / sizeof(tests[0]); t++) {
+    double value[2], error[2];
+    for (int run = 0; run < 2; run++) {
+      int nb_threads = (run == 0) ? 1 : max_threads;
+      omp_set_num_threads(nb_threads);
+      time = omp_get_wtime();
+      value[run] = monte_carlo(tests[t].f, &pi, tests[t].dim, samples, seed, &error[run]);
+      time = omp_get_wtime() - time;
+      printf("%s: %.12f +/- %.1le, %.3le samples/s (%d threads)\n", tests[t].name,
+             value[run], error[run], samples / time, nb_threads);
+    }
+    omp_set_num_threads(max_threads);
+    if (memcmp(&value[0], &value[1], sizeof(double)) != 0 ||
+        !(fabs(value[0] - tests[t].exact) <= MC_SIGMAS * error[0]))
+      ok = 0;
+  }
+  if (!ok) {
+    printf("Bad Monte Carlo results :-(((\n");
+    exit(1);
+  }
+  printf("OK Monte Carlo results :-)\n");
+}
+
+int main(int argc, char* argv[]) {
   double pi, pi_ref;
   double time_reference, time_kernel, speedup, efficiency; 
+  double pi_simd_result, time_simd;
+  int max_threads = omp_get_max_threads();
+
+  pi_simd_init();
+
+  // Adaptive integration mode: tp2_2_pi integrate [tolerance]
+  if (argc > 1 && strcmp(argv[1], "integrate") == 0) {
+    integrate_benchmark((argc > 2) ? atof(argv[2]) : 0.1 * ERROR);
+    return 0;
+  }
+
+  // Monte Carlo mode: tp2_2_pi mc [samples] [seed]
+  if (argc > 1 && strcmp(argv[1], "mc") == 0) {
+    long long samples = (argc > 2) ? atoll(argv[2]) : MC_SAMPLES;
+    if (samples <= 0) {
+      fprintf(stderr, "usage: %s mc [samples > 0] [seed]\n", argv[0]);
+      return 1;
+    }
+    monte_carlo_benchmark((size_t)samples, (argc > 3) ? (uint64_t)atoll(argv[3]) : 0);
+    return 0;
+  }
     
   time_reference = omp_get_wtime();
   pi_reference(N, &pi_ref);
@@ -71,6 +627,32 @@ int main() {
     exit(1);
   }
   printf("OK results :-)\n");
+
+  // SIMD kernel: one core first, then every thread
+  omp_set_num_threads(1);
+  time_simd = omp_get_wtime();
+  pi_simd_kernel(N, &pi_simd_result);
+  time_simd = omp_get_wtime() - time_simd;
+  omp_set_num_threads(max_threads);
+  printf("\nSIMD ISA ----- : %s\n", pi_simd_isa);
+  printf("SIMD 1 thread  : %3.5lf s (speedup %3.5lf)\n",
+         time_simd, time_reference / time_simd);
+  if (fabs(pi_ref - pi_simd_result) > ERROR) {
+    printf("Bad SIMD results :-(((\n");
+    exit(1);
+  }
+
+  time_simd = omp_get_wtime();
+  pi_simd_kernel(N, &pi_simd_result);
+  time_simd = omp_get_wtime() - time_simd;
+  printf("SIMD %2d threads: %3.5lf s (speedup %3.5lf)\n",
+         max_threads, time_simd, time_reference / time_simd);
+  printf("Pi SIMD ------ : %.22g\n", pi_simd_result);
+  if (fabs(pi_ref - pi_simd_result) > ERROR) {
+    printf("Bad SIMD results :-(((\n");
+    exit(1);
+  }
+  printf("OK SIMD results :-)\n");
   
   return 0;
 }
@@ -1,7 +1,14 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 #include <time.h>
 #include <omp.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86 1
+#endif
+#define min(x, y) ((x) < (y) ? (x) : (y))
 #define HYPERTHREADING 1 // 1 if hyperthreading is on, 0 otherwise
 #define ERROR 1.e-20     // Acceptable precision
 #define MAX_VAL 5        // Random values are [0, MAX_VAL]
@@ -9,22 +16,23 @@
 // Matrix and vector sizes (5120: UHD TV)
 #define N 10240
 
-// Reference computation kernel 
-void enumeration_sort_reference(double tab[N])
+// Reference computation kernel, for n elements (also used by the "bench"
+// mode and for the small arrays of sample_sort)
+void enumeration_sort(size_t n, double tab[n])
 {
   size_t i, j;
-  size_t *position = malloc(N * sizeof(size_t));
-  double *copy = malloc(N * sizeof(size_t));
+  size_t *position = malloc(n * sizeof(size_t));
+  double *copy = malloc(n * sizeof(double));
 
-  for (i = 0; i < N; i++)
+  for (i = 0; i < n; i++)
   {
     position[i] = 0;
     copy[i] = tab[i];
   }
 
-  for (j = 0; j < N; j++)
+  for (j = 0; j < n; j++)
   {
-    for (i = 0; i < N; i++)
+    for (i = 0; i < n; i++)
     {
       if ((tab[j] < tab[i]) || ((tab[i] == tab[j]) && (i < j)))
       {
@@ -33,13 +41,18 @@ void enumeration_sort_reference(double tab[N])
     }
   }
 
-  for (i = 0; i < N; i++)
+  for (i = 0; i < n; i++)
     tab[position[i]] = copy[i];
 
   free(position);
   free(copy);
 }
 
+void enumeration_sort_reference(double tab[N])
+{
+  enumeration_sort(N, tab);
+}
+
 // Computation kernel 
 void enumeration_sort_kernel(double tab[N])
 {
@@ -77,6 +90,88 @@ void enumeration_sort_kernel(double tab[N])
   free(copy);
 }
 
+/**
+ * Atomic-free enumeration sort:
+ * same ranks as enumeration_sort_kernel, computed the other way around:
+ * the rank of key i is owned by the thread of i, which compares key i to
+ * every key j itself, so nothing is shared in the hot loop (no atomic, no
+ * false sharing, output identical to the reference). Keys are compared
+ * by blocks of RANK_BLOCK (L1 resident) against RANK_ROWS keys at once, so
+ * each loaded block element serves RANK_ROWS comparisons. The inner loop
+ * is branch-free: each comparison gives a 0/1 that is accumulated in a
+ * vector of counters (the mask subtraction form of a popcount).
+ */
+#define RANK_TILE  256  // Keys whose ranks are accumulated together
+#define RANK_BLOCK 2048 // Keys compared per pass (16 KB, in L1)
+#define RANK_ROWS  4    // Keys compared against the same block element
+
+#ifdef SIMD_X86
+#define RANK_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define RANK_CLONES
+#endif
+
+// rank[i - i0] += #{j in [j0, j1): keys[j] < keys[i] or (keys[j] == keys[i] and j > i)}
+RANK_CLONES
+static void enumeration_rank_block(const double *keys, long i0, long i1, long j0, long j1,
+                                   long *rank)
+{
+  long i = i0;
+
+  for (; i + RANK_ROWS <= i1; i += RANK_ROWS)
+  {
+    double v0 = keys[i], v1 = keys[i + 1], v2 = keys[i + 2], v3 = keys[i + 3];
+    long c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+    #pragma omp simd reduction(+:c0, c1, c2, c3)
+    for (long j = j0; j < j1; j++)
+    {
+      double t = keys[j];
+      c0 += (t < v0) | ((t == v0) & (j > i));
+      c1 += (t < v1) | ((t == v1) & (j > i + 1));
+      c2 += (t < v2) | ((t == v2) & (j > i + 2));
+      c3 += (t < v3) | ((t == v3) & (j > i + 3));
+    }
+    rank[i - i0] += c0;
+    rank[i + 1 - i0] += c1;
+    rank[i + 2 - i0] += c2;
+    rank[i + 3 - i0] += c3;
+  }
+  for (; i < i1; i++)
+  {
+    double v = keys[i];
+    long c = 0;
+    #pragma omp simd reduction(+:c)
+    for (long j = j0; j < j1; j++)
+      c += (keys[j] < v) | ((keys[j] == v) & (j > i));
+    rank[i - i0] += c;
+  }
+}
+
+// Computation kernel without synchronization in the comparison loop
+void enumeration_sort_rank_kernel(double tab[N])
+{
+  double *copy = malloc(N * sizeof(double));
+
+  #pragma omp parallel
+  {
+    #pragma omp for schedule(static)
+    for (size_t i = 0; i < N; i++)
+      copy[i] = tab[i];
+
+    // Ranks of RANK_TILE keys per iteration, accumulated block by block
+    #pragma omp for schedule(static)
+    for (long ib = 0; ib < N; ib += RANK_TILE)
+    {
+      long ie = min(ib + RANK_TILE, N), rank[RANK_TILE] = {0};
+      for (long jb = 0; jb < N; jb += RANK_BLOCK)
+        enumeration_rank_block(copy, ib, ie, jb, min(jb + RANK_BLOCK, N), rank);
+      for (long i = ib; i < ie; i++)
+        tab[rank[i - ib]] = copy[i];
+    }
+  }
+  free(copy);
+}
+
 void print_sample(double tab[], size_t size, size_t sample_length)
 {
   if (size <= 2 * sample_length)
@@ -95,11 +190,721 @@ void print_sample(double tab[], size_t size, size_t sample_length)
   printf("\n");
 }
 
-int main()
+/**
+ * Sample sort:
+ * parallel sort of n doubles with T threads. Each thread sorts its
+ * contiguous chunk (local_sort), takes SORT_OVERSAMPLING regularly spaced
+ * samples of it, T - 1 splitters are chosen among the sorted samples,
+ * they cut every sorted chunk into T segments (binary searches). A prefix
+ * sum of the segment sizes gives the place of each segment in the output
+ * (all segments of bucket 0 first, in thread order, then bucket 1...) and
+ * every thread copies its segments there (all-to-all exchange). Thread b
+ * finally merges the T sorted runs of bucket b. Small arrays use the
+ * enumeration sort.
+ */
+#define SORT_SMALL        64      // Up to this size, sort by enumeration
+#define SORT_INSERTION    16      // Up to this size, local_sort uses insertion sort
+#define SORT_MIN_CHUNK    16384   // Minimum number of keys per thread
+#define SORT_OVERSAMPLING 64      // Samples per thread for the splitters
+#define SORT_BENCH_MAX    10000000 // Default largest size of the "bench" mode
+#define SORT_ENUMERATION_MAX 20000  // Largest size timed with the enumeration sort
+
+// Sequential quicksort (median of 3, Hoare partition), insertion sort at the leaves
+static void local_sort(size_t n, double *a)
+{
+  while (n > SORT_INSERTION)
+  {
+    double x = a[0], y = a[n / 2], z = a[n - 1];
+    double pivot = (x < y) ? ((y < z) ? y : ((x < z) ? z : x))
+                           : ((x < z) ? x : ((y < z) ? z : y));
+    size_t i = (size_t)-1, j = n;
+    for (;;)
+    {
+      do
+        i++;
+      while (a[i] < pivot);
+      do
+        j--;
+      while (a[j] > pivot);
+      if (i >= j)
+        break;
+      double tmp = a[i];
+      a[i] = a[j];
+      a[j] = tmp;
+    }
+    // [0, j] <= pivot <= [j + 1, n): recursion on the smaller part
+    if (j + 1 < n - j - 1)
+    {
+      local_sort(j + 1, a);
+      a += j + 1;
+      n -= j + 1;
+    }
+    else
+    {
+      local_sort(n - j - 1, a + j + 1);
+      n = j + 1;
+    }
+  }
+  for (size_t i = 1; i < n; i++)
+  {
+    double v = a[i];
+    size_t j = i;
+    for (; j > 0 && a[j - 1] > v; j--)
+      a[j] = a[j - 1];
+    a[j] = v;
+  }
+}
+
+// First index of the sorted a[0, n) whose element is >= value
+static size_t lower_bound(size_t n, double *a, double value)
+{
+  size_t lo = 0, hi = n;
+  while (lo < hi)
+  {
+    size_t mid = lo + (hi - lo) / 2;
+    if (a[mid] < value)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+// Merges the sorted runs src[start[r], end[r]) into dst (binary min-heap of runs)
+static void merge_runs(int runs, double *src, size_t *start, size_t *end, double *dst)
 {
+  int heap[runs], size = 0;
+  size_t pos[runs];
+
+  for (int r = 0; r < runs; r++)
+  {
+    pos[r] = start[r];
+    if (pos[r] == end[r])
+      continue;
+    int c = size++; // Sift up
+    while (c > 0 && src[pos[heap[(c - 1) / 2]]] > src[pos[r]])
+    {
+      heap[c] = heap[(c - 1) / 2];
+      c = (c - 1) / 2;
+    }
+    heap[c] = r;
+  }
+  while (size > 0)
+  {
+    int r = heap[0];
+    *dst++ = src[pos[r]++];
+    if (pos[r] == end[r])
+      r = heap[--size];
+    int c = 0; // Sift down r from the root
+    for (;;)
+    {
+      int child = 2 * c + 1;
+      if (child >= size)
+        break;
+      if (child + 1 < size && src[pos[heap[child + 1]]] < src[pos[heap[child]]])
+        child++;
+      if (src[pos[heap[child]]] >= src[pos[r]])
+        break;
+      heap[c] = heap[child];
+      c = child;
+    }
+    if (size > 0)
+      heap[c] = r;
+  }
+}
+
+/**
+ * sample_sort function:
+ * this function sorts the n elements of tab in ascending order.
+ * \param buffer is a preallocated array of n elements used for the exchange
+ */
+void sample_sort(size_t n, double tab[n], double buffer[n])
+{
+  int T = omp_get_max_threads();
+
+  if (n <= SORT_SMALL)
+  {
+    enumeration_sort(n, tab);
+    return;
+  }
+  if ((size_t)T > n / SORT_MIN_CHUNK)
+    T = (int)(n / SORT_MIN_CHUNK);
+  if (T <= 1)
+  {
+    local_sort(n, tab);
+    return;
+  }
+
+  double *samples = malloc(T * SORT_OVERSAMPLING * sizeof(double));
+  double *splitters = malloc((T - 1) * sizeof(double));
+  size_t *bound = malloc(T * (T + 1) * sizeof(size_t)); // Segment (t, b) is [bound[t][b], bound[t][b + 1])
+  size_t *offset = malloc((T * T + 1) * sizeof(size_t)); // Output place of segment (t, b): offset[b T + t]
+
+  #pragma omp parallel num_threads(T)
+  {
+    int t = omp_get_thread_num();
+    size_t lo = n * t / T, hi = n * (t + 1) / T;
+
+    // Local sort and regular sampling
+    local_sort(hi - lo, tab + lo);
+    for (size_t s = 0; s < SORT_OVERSAMPLING; s++)
+      samples[t * SORT_OVERSAMPLING + s] = tab[lo + (hi - lo) * (2 * s + 1) / (2 * SORT_OVERSAMPLING)];
+    #pragma omp barrier
+
+    #pragma omp single
+    {
+      local_sort(T * SORT_OVERSAMPLING, samples);
+      for (int b = 1; b < T; b++)
+        splitters[b - 1] = samples[b * SORT_OVERSAMPLING];
+    }
+
+    // Segments of the chunk: bucket b gets [splitters[b - 1], splitters[b])
+    bound[t * (T + 1)] = lo;
+    for (int b = 1; b < T; b++)
+      bound[t * (T + 1) + b] = lo + lower_bound(hi - lo, tab + lo, splitters[b - 1]);
+    bound[t * (T + 1) + T] = hi;
+    #pragma omp barrier
+
+    #pragma omp single
+    {
+      offset[0] = 0;
+      for (int b = 0; b < T; b++)
+        for (int u = 0; u < T; u++)
+          offset[b * T + u + 1] = offset[b * T + u] +
+                                  bound[u * (T + 1) + b + 1] - bound[u * (T + 1) + b];
+    }
+
+    // All-to-all exchange
+    for (int b = 0; b < T; b++)
+    {
+      size_t first = bound[t * (T + 1) + b], last = bound[t * (T + 1) + b + 1];
+      memcpy(buffer + offset[b * T + t], tab + first, (last - first) * sizeof(double));
+    }
+    #pragma omp barrier
+
+    // Merge of the T runs of bucket t
+    merge_runs(T, buffer, offset + t * T, offset + t * T + 1, tab + offset[t * T]);
+  }
+
+  free(samples);
+  free(splitters);
+  free(bound);
+  free(offset);
+}
+
+static int compare_doubles(const void *x, const void *y)
+{
+  double a = *(const double *)x, b = *(const double *)y;
+  return (a > b) - (a < b);
+}
+
+/**
+ * LSD radix sort:
+ * keys are mapped to unsigned integers with the same order (sign bit
+ * flipped for signed integers, sign bit flipped for positive doubles and
+ * every bit flipped for negative ones), then sorted RADIX_BITS bits at a
+ * time from the least significant digit, each pass being stable. A pass
+ * runs with T threads on contiguous chunks: per-thread histograms of the
+ * digit, a prefix sum over (digit, thread) giving where each thread writes
+ * each digit, then the scatter. Scattered keys go through a software
+ * write-combining buffer of one cache line per digit, flushed to the
+ * output a full aligned line at a time with non-temporal stores (no read
+ * for ownership of the destination lines, which are not reused before the
+ * next pass) instead of 256 scattered streams of single stores. Passes
+ * where every key has the same digit (e.g. the high bytes of small
+ * integers) are detected from global histograms and skipped. An optional
+ * payload (index) array moves with the keys, which gives the key/value
+ * sort and argsort.
+ */
+#define RADIX_BITS      8                 // Bits per digit
+#define RADIX_DIGITS    (1 << RADIX_BITS) // Buckets per pass
+#define RADIX_LINE      64                // Bytes of a write-combining buffer
+#define RADIX_MIN_CHUNK 65536             // Minimum number of keys per thread
+
+static inline uint64_t radix_load(const void *a, size_t i, int wide)
+{
+  return wide ? ((const uint64_t *)a)[i] : ((const uint32_t *)a)[i];
+}
+
+// Copies bytes (whole aligned lines if stream) with non-temporal stores if stream
+static inline void radix_flush(void *dst, const void *src, size_t bytes, int stream)
+{
+#ifdef SIMD_X86
+  if (stream)
+  {
+    for (size_t b = 0; b < bytes; b += 16)
+      _mm_stream_si128((__m128i *)((unsigned char *)dst + b),
+                       _mm_load_si128((const __m128i *)((const unsigned char *)src + b)));
+    return;
+  }
+#endif
+  memcpy(dst, src, bytes);
+}
+
+// Buffer of bytes aligned on RADIX_LINE (aligned_alloc wants a multiple of it)
+static void *radix_alloc(size_t bytes)
+{
+  return aligned_alloc(RADIX_LINE, (bytes + RADIX_LINE - 1) / RADIX_LINE * RADIX_LINE);
+}
+
+// Number of threads for n keys (at least RADIX_MIN_CHUNK keys per thread)
+static int radix_threads(size_t n)
+{
+  size_t T = (size_t)omp_get_max_threads();
+  if (T > n / RADIX_MIN_CHUNK)
+    T = (n / RADIX_MIN_CHUNK > 0) ? n / RADIX_MIN_CHUNK : 1;
+  return (int)T;
+}
+
+/**
+ * radix_sort_thread function:
+ * part of the sort of the n unsigned keys of keys (64-bit if wide, 32-bit
+ * otherwise) done by the calling thread of a team of T, payload following
+ * if not NULL. tmp (and tmp_payload) are work arrays of n elements, counts
+ * is shared by the team (T (64 / RADIX_BITS) RADIX_DIGITS elements).
+ * Always inlined inside the parallel region of radix_sort_u64/u32 with a
+ * constant wide, so the key size is known at compile time in the loops.
+ */
+static inline __attribute__((always_inline))
+void radix_sort_thread(size_t n, int wide, int T, void *keys, void *tmp, size_t *payload,
+                       size_t *tmp_payload, size_t *counts)
+{
+  const int key_bytes = wide ? 8 : 4, passes = 8 * key_bytes / RADIX_BITS;
+  const size_t line = RADIX_LINE / key_bytes; // Keys per write-combining line
+  int t = omp_get_thread_num(), skip[64 / RADIX_BITS], moved = 0;
+  size_t lo = n * t / T, hi = n * (t + 1) / T;
+  size_t *count = counts + t * passes * RADIX_DIGITS;
+
+  // Histograms of every digit: passes where all keys share a digit are skipped
+  for (int d = 0; d < passes * RADIX_DIGITS; d++)
+    count[d] = 0;
+  for (size_t i = lo; i < hi; i++)
+  {
+    uint64_t k = radix_load(keys, i, wide);
+    for (int p = 0; p < passes; p++)
+      count[p * RADIX_DIGITS + ((k >> (p * RADIX_BITS)) & (RADIX_DIGITS - 1))]++;
+  }
+  #pragma omp barrier
+  uint64_t first = radix_load(keys, 0, wide);
+  for (int p = 0; p < passes; p++)
+  {
+    size_t same = 0, d = (first >> (p * RADIX_BITS)) & (RADIX_DIGITS - 1);
+    for (int u = 0; u < T; u++)
+      same += counts[(u * passes + p) * RADIX_DIGITS + d];
+    skip[p] = (same == n);
+  }
+  #pragma omp barrier // counts is overwritten by the first pass
+
+  unsigned char *wc = radix_alloc(RADIX_DIGITS * RADIX_LINE);
+  size_t *wc_payload = radix_alloc(RADIX_DIGITS * line * sizeof(size_t));
+  size_t fill[RADIX_DIGITS], pos[RADIX_DIGITS];
+  void *src = keys, *dst = tmp;
+  size_t *src_payload = payload, *dst_payload = tmp_payload;
+  int stream_keys = ((uintptr_t)keys % RADIX_LINE == 0) && ((uintptr_t)tmp % RADIX_LINE == 0);
+  int stream_payload = ((uintptr_t)payload % RADIX_LINE == 0) &&
+                       ((uintptr_t)tmp_payload % RADIX_LINE == 0);
+
+  for (int p = 0; p < passes; p++)
+  {
+    int shift = p * RADIX_BITS;
+    if (skip[p])
+      continue;
+
+    // Histogram of the digit in the chunk
+    for (int d = 0; d < RADIX_DIGITS; d++)
+      count[d] = 0;
+    for (size_t i = lo; i < hi; i++)
+      count[(radix_load(src, i, wide) >> shift) & (RADIX_DIGITS - 1)]++;
+    #pragma omp barrier
+
+    // Start of (digit d, thread t): keys of smaller digits, then of the
+    // same digit in the chunks of the threads before t. The buffer of d
+    // is filled from the offset of pos[d] in its output line, so that
+    // every flush after the first one writes a whole aligned line.
+    size_t start = 0;
+    for (int d = 0; d < RADIX_DIGITS; d++)
+    {
+      for (int u = 0; u < T; u++)
+      {
+        if (u == t)
+          pos[d] = start;
+        start += counts[u * passes * RADIX_DIGITS + d];
+      }
+      fill[d] = pos[d] % line;
+    }
+    #pragma omp barrier // counts is overwritten by the next pass
+
+    // Scatter through the write-combining buffers
+    for (size_t i = lo; i < hi; i++)
+    {
+      uint64_t k = radix_load(src, i, wide);
+      int d = (k >> shift) & (RADIX_DIGITS - 1);
+      size_t f = fill[d];
+      if (wide)
+        ((uint64_t *)(wc + d * RADIX_LINE))[f] = k;
+      else
+        ((uint32_t *)(wc + d * RADIX_LINE))[f] = (uint32_t)k;
+      if (payload != NULL)
+        wc_payload[d * line + f] = src_payload[i];
+      if (f + 1 < line)
+      {
+        fill[d] = f + 1;
+        continue;
+      }
+      size_t first = pos[d] % line; // Not 0 for the first line of d only
+      radix_flush((unsigned char *)dst + pos[d] * key_bytes, wc + d * RADIX_LINE + first * key_bytes,
+                  (line - first) * key_bytes, stream_keys && first == 0);
+      if (payload != NULL)
+        radix_flush(dst_payload + pos[d], wc_payload + d * line + first,
+                    (line - first) * sizeof(size_t), stream_payload && first == 0);
+      pos[d] += line - first;
+      fill[d] = 0;
+    }
+    for (int d = 0; d < RADIX_DIGITS; d++)
+    {
+      size_t first = pos[d] % line;
+      memcpy((unsigned char *)dst + pos[d] * key_bytes, wc + d * RADIX_LINE + first * key_bytes,
+             (fill[d] - first) * key_bytes);
+      if (payload != NULL)
+        memcpy(dst_payload + pos[d], wc_payload + d * line + first,
+               (fill[d] - first) * sizeof(size_t));
+    }
+#ifdef SIMD_X86
+    _mm_sfence(); // Streaming stores are weakly ordered
+#endif
+    #pragma omp barrier
+
+    void *swap = src;
+    src = dst;
+    dst = swap;
+    size_t *swap_payload = src_payload;
+    src_payload = dst_payload;
+    dst_payload = swap_payload;
+    moved = !moved;
+  }
+
+  // Odd number of passes: the result is in tmp, copy it back
+  if (moved)
+  {
+    memcpy((unsigned char *)keys + lo * key_bytes, (unsigned char *)tmp + lo * key_bytes,
+           (hi - lo) * key_bytes);
+    if (payload != NULL)
+      memcpy(payload + lo, tmp_payload + lo, (hi - lo) * sizeof(size_t));
+  }
+  free(wc);
+  free(wc_payload);
+}
+
+static void radix_sort_u64(size_t n, uint64_t *keys, uint64_t *tmp, size_t *payload,
+                           size_t *tmp_payload)
+{
+  int T = radix_threads(n);
+  size_t *counts = malloc(T * 8 * RADIX_DIGITS * sizeof(size_t));
+
+  if (n > 1)
+  {
+    #pragma omp parallel num_threads(T)
+    radix_sort_thread(n, 1, T, keys, tmp, payload, tmp_payload, counts);
+  }
+  free(counts);
+}
+
+static void radix_sort_u32(size_t n, uint32_t *keys, uint32_t *tmp, size_t *payload,
+                           size_t *tmp_payload)
+{
+  int T = radix_threads(n);
+  size_t *counts = malloc(T * 4 * RADIX_DIGITS * sizeof(size_t));
+
+  if (n > 1)
+  {
+    #pragma omp parallel num_threads(T)
+    radix_sort_thread(n, 0, T, keys, tmp, payload, tmp_payload, counts);
+  }
+  free(counts);
+}
+
+// Order-preserving map of doubles to unsigned integers, and its inverse
+static inline uint64_t double_to_key(double x)
+{
+  uint64_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  return bits ^ ((uint64_t)((int64_t)bits >> 63) | 0x8000000000000000ull);
+}
+
+static inline double key_to_double(uint64_t key)
+{
+  uint64_t bits = (key & 0x8000000000000000ull) ? key ^ 0x8000000000000000ull : ~key;
+  double x;
+  memcpy(&x, &bits, sizeof(x));
+  return x;
+}
+
+// Sorts keys (and payload if not NULL) of n doubles in ascending order
+static void radix_sort_doubles(size_t n, double *a, size_t *payload)
+{
+  uint64_t *keys = radix_alloc(n * sizeof(uint64_t));
+  uint64_t *tmp = radix_alloc(n * sizeof(uint64_t));
+  size_t *tmp_payload = (payload != NULL) ? radix_alloc(n * sizeof(size_t)) : NULL;
+
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; i++)
+    keys[i] = double_to_key(a[i]);
+  radix_sort_u64(n, keys, tmp, payload, tmp_payload);
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; i++)
+    a[i] = key_to_double(keys[i]);
+
+  free(keys);
+  free(tmp);
+  free(tmp_payload);
+}
+
+/**
+ * radix_sort_double, radix_sort_int64, radix_sort_int32 functions:
+ * these functions sort the n elements of a in ascending order (-0.0 is
+ * placed before +0.0, NaNs with the sign bit clear after +inf).
+ */
+void radix_sort_double(size_t n, double *a)
+{
+  radix_sort_doubles(n, a, NULL);
+}
+
+void radix_sort_int64(size_t n, int64_t *a)
+{
+  uint64_t *keys = radix_alloc(n * sizeof(uint64_t));
+  uint64_t *tmp = radix_alloc(n * sizeof(uint64_t));
+
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; i++)
+    keys[i] = (uint64_t)a[i] ^ 0x8000000000000000ull;
+  radix_sort_u64(n, keys, tmp, NULL, NULL);
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; i++)
+    a[i] = (int64_t)(keys[i] ^ 0x8000000000000000ull);
+  free(keys);
+  free(tmp);
+}
+
+void radix_sort_int32(size_t n, int32_t *a)
+{
+  uint32_t *keys = radix_alloc(n * sizeof(uint32_t));
+  uint32_t *tmp = radix_alloc(n * sizeof(uint32_t));
+
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; i++)
+    keys[i] = (uint32_t)a[i] ^ 0x80000000u;
+  radix_sort_u32(n, keys, tmp, NULL, NULL);
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; i++)
+    a[i] = (int32_t)(keys[i] ^ 0x80000000u);
+  free(keys);
+  free(tmp);
+}
+
+/**
+ * radix_sort_pairs function:
+ * this function sorts the n (keys[i], payload[i]) pairs by key, equal keys
+ * keeping their relative order (stable).
+ */
+void radix_sort_pairs(size_t n, double *keys, size_t *payload)
+{
+  radix_sort_doubles(n, keys, payload);
+}
+
+/**
+ * argsort function:
+ * this function writes in index the permutation that sorts keys (left
+ * unchanged): keys[index[0]] <= keys[index[1]] <= ..., equal keys in the
+ * order of their indices, to sort records through their keys. A 64-byte
+ * aligned index is also written with non-temporal stores.
+ */
+void argsort(size_t n, const double *keys, size_t *index)
+{
+  uint64_t *radix_keys = radix_alloc(n * sizeof(uint64_t));
+  uint64_t *tmp = radix_alloc(n * sizeof(uint64_t));
+  size_t *tmp_index = radix_alloc(n * sizeof(size_t));
+
+  #pragma omp parallel for schedule(static)
+  for (size_t i = 0; i < n; i++)
+  {
+    radix_keys[i] = double_to_key(keys[i]);
+    index[i] = i;
+  }
+  radix_sort_u64(n, radix_keys, tmp, index, tmp_index);
+
+  free(radix_keys);
+  free(tmp);
+  free(tmp_index);
+}
+
+static int compare_int64(const void *x, const void *y)
+{
+  int64_t a = *(const int64_t *)x, b = *(const int64_t *)y;
+  return (a > b) - (a < b);
+}
+
+static int compare_int32(const void *x, const void *y)
+{
+  int32_t a = *(const int32_t *)x, b = *(const int32_t *)y;
+  return (a > b) - (a < b);
+}
+
+/**
+ * radix_check function:
+ * this function checks radix_sort_int64 (full-range signed keys),
+ * radix_sort_int32 (small signed keys: skipped passes, many ties) and
+ * radix_sort_pairs (negative doubles with many ties: stability of the
+ * payload) against qsort on n keys derived from keys. a, ref and payload
+ * are n-element work arrays.
+ */
+static void radix_check(size_t n, const double *keys, double *a, double *ref, size_t *payload)
+{
+  int64_t *a64 = malloc(n * sizeof(int64_t)), *ref64 = malloc(n * sizeof(int64_t));
+  int32_t *a32 = malloc(n * sizeof(int32_t)), *ref32 = malloc(n * sizeof(int32_t));
+
+  for (size_t i = 0; i < n; i++)
+  {
+    ref64[i] = a64[i] = (int64_t)((keys[i] - MAX_VAL / 2.) * 1.e18);
+    ref32[i] = a32[i] = (int32_t)(keys[i] * 400.) - 1000;
+    ref[i] = a[i] = (double)(int)(keys[i] * 100.) / 100. - MAX_VAL / 2.;
+    payload[i] = i;
+  }
+  qsort(ref64, n, sizeof(int64_t), compare_int64);
+  qsort(ref32, n, sizeof(int32_t), compare_int32);
+  qsort(ref, n, sizeof(double), compare_doubles);
+
+  radix_sort_int64(n, a64);
+  radix_sort_int32(n, a32);
+  radix_sort_pairs(n, a, payload);
+  if (memcmp(a64, ref64, n * sizeof(int64_t)) != 0 ||
+      memcmp(a32, ref32, n * sizeof(int32_t)) != 0)
+  {
+    printf("Bad radix integer sort results :-(((\n");
+    exit(1);
+  }
+  for (size_t i = 0; i < n; i++)
+  {
+    double key = (double)(int)(keys[payload[i]] * 100.) / 100. - MAX_VAL / 2.;
+    if (a[i] != ref[i] || key != a[i] ||
+        (i > 0 && a[i] == a[i - 1] && payload[i] < payload[i - 1]))
+    {
+      printf("Bad radix pair sort results :-(((\n");
+      exit(1);
+    }
+  }
+
+  free(a64);
+  free(ref64);
+  free(a32);
+  free(ref32);
+}
+
+/**
+ * sort_benchmark function:
+ * this function times qsort, sample_sort, radix_sort_double, argsort and
+ * (up to SORT_ENUMERATION_MAX) the reference enumeration sort for 1e4,
+ * 1e5... up to max random keys and checks that all of them give the same
+ * result, and checks the other radix sorts with radix_check.
+ */
+void sort_benchmark(size_t max)
+{
+  double *keys = malloc(max * sizeof(double));
+  double *a = malloc(max * sizeof(double));
+  double *ref = malloc(max * sizeof(double));
+  double *buffer = malloc(max * sizeof(double));
+  size_t *index = radix_alloc(max * sizeof(size_t));
+
+  srand((unsigned int)time(NULL));
+  for (size_t i = 0; i < max; i++)
+    keys[i] = (float)rand() / (float)(RAND_MAX / MAX_VAL);
+
+  printf("%d threads\n", omp_get_max_threads());
+  printf("%12s %12s %12s %9s %12s %9s %12s %12s\n", "keys", "qsort (s)", "sample (s)",
+         "speedup", "radix (s)", "speedup", "argsort (s)", "enum (s)");
+  for (size_t n = 10000; n <= max; n *= 10)
+  {
+    double time_qsort, time_sample, time_radix, time_argsort, time_enumeration = 0.;
+
+    memcpy(ref, keys, n * sizeof(double));
+    time_qsort = omp_get_wtime();
+    qsort(ref, n, sizeof(double), compare_doubles);
+    time_qsort = omp_get_wtime() - time_qsort;
+
+    memcpy(a, keys, n * sizeof(double));
+    time_sample = omp_get_wtime();
+    sample_sort(n, a, buffer);
+    time_sample = omp_get_wtime() - time_sample;
+    if (memcmp(a, ref, n * sizeof(double)) != 0)
+    {
+      printf("Bad sample sort results :-(((\n");
+      exit(1);
+    }
+
+    memcpy(a, keys, n * sizeof(double));
+    time_radix = omp_get_wtime();
+    radix_sort_double(n, a);
+    time_radix = omp_get_wtime() - time_radix;
+    if (memcmp(a, ref, n * sizeof(double)) != 0)
+    {
+      printf("Bad radix sort results :-(((\n");
+      exit(1);
+    }
+
+    time_argsort = omp_get_wtime();
+    argsort(n, keys, index);
+    time_argsort = omp_get_wtime() - time_argsort;
+    for (size_t i = 0; i < n; i++)
+    {
+      if (keys[index[i]] != ref[i] || (i > 0 && keys[index[i]] == keys[index[i - 1]] &&
+                                       index[i] < index[i - 1]))
+      {
+        printf("Bad argsort results :-(((\n");
+        exit(1);
+      }
+    }
+
+    if (n <= SORT_ENUMERATION_MAX)
+    {
+      memcpy(a, keys, n * sizeof(double));
+      time_enumeration = omp_get_wtime();
+      enumeration_sort(n, a);
+      time_enumeration = omp_get_wtime() - time_enumeration;
+      if (memcmp(a, ref, n * sizeof(double)) != 0)
+      {
+        printf("Bad enumeration sort results :-(((\n");
+        exit(1);
+      }
+    }
+    radix_check(n, keys, a, ref, index); // Overwrites a, ref and index
+    printf("%12zu %12.5lf %12.5lf %9.3lf %12.5lf %9.3lf %12.5lf ", n, time_qsort, time_sample,
+           time_qsort / time_sample, time_radix, time_qsort / time_radix, time_argsort);
+    if (n <= SORT_ENUMERATION_MAX)
+      printf("%12.5lf\n", time_enumeration);
+    else
+      printf("%12s\n", "-");
+  }
+  printf("OK sort results :-)\n");
+
+  free(keys);
+  free(a);
+  free(ref);
+  free(buffer);
+  free(index);
+}
+
+int main(int argc, char *argv[])
+{
+  // Benchmark mode: tp2_3_enumeration_sort bench [max keys] (about 88 bytes per key)
+  if (argc > 1 && strcmp(argv[1], "bench") == 0)
+  {
+    sort_benchmark((argc > 2) ? (size_t)atof(argv[2]) : SORT_BENCH_MAX);
+    return 0;
+  }
+
   double *a = malloc(N * sizeof(double));
   double *ref = malloc(N * sizeof(double));
-  double time_reference, time_kernel, speedup, efficiency;
+  double *b = malloc(N * sizeof(double));
+  double time_reference, time_kernel, time_rank, speedup, efficiency;
 
   // Initialization by random values
   srand((unsigned int)time(NULL));
@@ -107,6 +912,7 @@ int main()
   {
     a[i] = (float)rand() / (float)(RAND_MAX / MAX_VAL);
     ref[i] = a[i];
+    b[i] = a[i];
   }
 
   time_reference = omp_get_wtime();
@@ -138,7 +944,26 @@ int main()
   }
   printf("OK results :-)\n");
 
+  // Atomic-free kernel
+  for (size_t i = 0; i < N; i++)
+    a[i] = b[i];
+  time_rank = omp_get_wtime();
+  enumeration_sort_rank_kernel(a);
+  time_rank = omp_get_wtime() - time_rank;
+  printf("Rank time ---- : %3.5lf s (speedup %3.5lf, %3.5lf over the kernel)\n", time_rank,
+         time_reference / time_rank, time_kernel / time_rank);
+  for (size_t i = 0; i < N; i++)
+  {
+    if (ref[i] != a[i])
+    {
+      printf("Bad rank results :-(((\n");
+      exit(1);
+    }
+  }
+  printf("OK rank results :-)\n");
+
   free(a);
+  free(b);
   free(ref);
   return 0;
 }
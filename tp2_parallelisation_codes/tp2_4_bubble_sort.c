@@ -1,7 +1,13 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <omp.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SIMD_X86 1
+#endif
+#define min(x, y) ((x) < (y) ? (x) : (y))
 #define HYPERTHREADING 1 // 1 if hyperthreading is on, 0 otherwise
 #define ERROR 1.e-20     // Acceptable precision
 #define MAX_VAL 500      // Random values are [0, MAX_VAL]
@@ -29,31 +35,326 @@ void bubble_sort_reference(double tab[N])
   }
 }
 
-// Computation kernel
-void bubble_sort_kernel(double tab[N])
+/**
+ * odd_even_sort function:
+ * parallel odd-even transposition sort of n elements: n phases, phase p
+ * compare-exchanges the pairs (i, i + 1) with i of the parity of p. Pairs
+ * of a phase are disjoint, so they are shared among the threads without
+ * any synchronization, the implicit barrier of the loop separates the
+ * phases. The loop stops early after two phases without exchange.
+ */
+void odd_even_sort(size_t n, double tab[n])
 {
-  size_t i, j;
-  double temp;
-#pragma omp parallel private(temp, i, j)
+  int swapped[3] = {1, 1, 1}; // Exchanges in phases p (mod 3), rotating to avoid a race
+
+  #pragma omp parallel
+  for (size_t p = 0; p < n; p++)
+  {
+    int now = p % 3;
+    if (p >= 2 && !swapped[(p + 1) % 3] && !swapped[(p + 2) % 3])
+      break; // Phases p - 2 and p - 1 were both exchange-free: sorted
+    #pragma omp single
+    swapped[now] = 0;
+    #pragma omp for reduction(|:swapped[now:1])
+    for (size_t i = p % 2; i < n - 1; i += 2)
+    {
+      double a = tab[i], b = tab[i + 1];
+      tab[i] = (b < a) ? b : a;
+      tab[i + 1] = (b < a) ? a : b;
+      swapped[now] |= (b < a);
+    }
+  }
+}
+
+/**
+ * Bitonic merge sort:
+ * blocks of sort_block elements are sorted in registers by a bitonic
+ * sorting network (AVX-512: 2 x 8 doubles, AVX2: 2 x 4 doubles), made of
+ * compare-exchange steps "min and max with a permutation of the register,
+ * then blend", without any branch. Sorted blocks are then merged two by
+ * two, level after level, each merge being split among the threads by
+ * co-ranking when there are fewer merges than threads (merge path).
+ */
+#define SORT_BENCH_MAX 10000000 // Default largest size of the "bench" mode
+#define ODD_EVEN_MAX   N        // Largest size timed with the odd-even sort (O(n^2))
+
+typedef void (*block_sorter)(double *a);
+
+// Insertion sort of 8 elements (fallback)
+static void block_sort_scalar(double *a)
+{
+  for (int i = 1; i < 8; i++)
+  {
+    double v = a[i];
+    int j = i;
+    for (; j > 0 && a[j - 1] > v; j--)
+      a[j] = a[j - 1];
+    a[j] = v;
+  }
+}
+
+#ifdef SIMD_X86
+// Compare-exchange of the lanes swapped by perm, maxima in the lanes of mask
+#define CMPX256(v, perm, mask)                                              \
+  do                                                                        \
+  {                                                                         \
+    __m256d p_ = _mm256_permute4x64_pd(v, perm);                            \
+    v = _mm256_blend_pd(_mm256_min_pd(v, p_), _mm256_max_pd(v, p_), mask);  \
+  } while (0)
+
+// Sorts 8 doubles: 2 bitonic sorts of 4 in registers, then a bitonic merge
+__attribute__((target("avx2")))
+static void block_sort_avx2(double *a)
+{
+  __m256d v0 = _mm256_loadu_pd(a), v1 = _mm256_loadu_pd(a + 4);
+
+  CMPX256(v0, 0xB1, 0x6); // (0, 1) ascending, (2, 3) descending
+  CMPX256(v1, 0xB1, 0x6);
+  CMPX256(v0, 0x4E, 0xC); // (0, 2), (1, 3)
+  CMPX256(v1, 0x4E, 0xC);
+  CMPX256(v0, 0xB1, 0xA); // (0, 1), (2, 3)
+  CMPX256(v1, 0xB1, 0xA);
+
+  // v0 with v1 reversed is bitonic: min and max split it in two halves
+  v1 = _mm256_permute4x64_pd(v1, 0x1B);
+  __m256d lo = _mm256_min_pd(v0, v1), hi = _mm256_max_pd(v0, v1);
+  CMPX256(lo, 0x4E, 0xC);
+  CMPX256(hi, 0x4E, 0xC);
+  CMPX256(lo, 0xB1, 0xA);
+  CMPX256(hi, 0xB1, 0xA);
+  _mm256_storeu_pd(a, lo);
+  _mm256_storeu_pd(a + 4, hi);
+}
+
+#define CMPX512(v, perm, mask)                                                           \
+  do                                                                                     \
+  {                                                                                      \
+    __m512d p_ = _mm512_permutexvar_pd(perm, v);                                         \
+    v = _mm512_mask_blend_pd(mask, _mm512_min_pd(v, p_), _mm512_max_pd(v, p_));          \
+  } while (0)
+
+// Sorts 16 doubles: 2 bitonic sorts of 8 in registers, then a bitonic merge
+__attribute__((target("avx512f")))
+static void block_sort_avx512(double *a)
+{
+  const __m512i swap1 = _mm512_set_epi64(6, 7, 4, 5, 2, 3, 0, 1);
+  const __m512i swap2 = _mm512_set_epi64(5, 4, 7, 6, 1, 0, 3, 2);
+  const __m512i swap4 = _mm512_set_epi64(3, 2, 1, 0, 7, 6, 5, 4);
+  const __m512i reverse = _mm512_set_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+  __m512d v0 = _mm512_loadu_pd(a), v1 = _mm512_loadu_pd(a + 8);
+
+  CMPX512(v0, swap1, 0x66); // Bitonic sequences of 4
+  CMPX512(v1, swap1, 0x66);
+  CMPX512(v0, swap2, 0x3C);
+  CMPX512(v1, swap2, 0x3C);
+  CMPX512(v0, swap1, 0x5A);
+  CMPX512(v1, swap1, 0x5A);
+  CMPX512(v0, swap4, 0xF0); // Ascending merge of 8
+  CMPX512(v1, swap4, 0xF0);
+  CMPX512(v0, swap2, 0xCC);
+  CMPX512(v1, swap2, 0xCC);
+  CMPX512(v0, swap1, 0xAA);
+  CMPX512(v1, swap1, 0xAA);
+
+  v1 = _mm512_permutexvar_pd(reverse, v1);
+  __m512d lo = _mm512_min_pd(v0, v1), hi = _mm512_max_pd(v0, v1);
+  CMPX512(lo, swap4, 0xF0);
+  CMPX512(hi, swap4, 0xF0);
+  CMPX512(lo, swap2, 0xCC);
+  CMPX512(hi, swap2, 0xCC);
+  CMPX512(lo, swap1, 0xAA);
+  CMPX512(hi, swap1, 0xAA);
+  _mm512_storeu_pd(a, lo);
+  _mm512_storeu_pd(a + 8, hi);
+}
+#endif
+
+static block_sorter block_sort = block_sort_scalar;
+static size_t sort_block = 8;
+static const char *sort_isa = "scalar";
+
+// Selects the widest sorting network supported by the CPU (CPUID)
+void block_sort_init(void)
+{
+#ifdef SIMD_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f"))
+  {
+    block_sort = block_sort_avx512;
+    sort_block = 16;
+    sort_isa = "avx512";
+  }
+  else if (__builtin_cpu_supports("avx2"))
+  {
+    block_sort = block_sort_avx2;
+    sort_block = 8;
+    sort_isa = "avx2";
+  }
+#endif
+}
+
+// Stable merge of the sorted a[0, na) and b[0, nb) into out
+static void merge(const double *a, size_t na, const double *b, size_t nb, double *out)
+{
+  size_t i = 0, j = 0;
+  while (i < na && j < nb)
+    *out++ = (b[j] < a[i]) ? b[j++] : a[i++];
+  while (i < na)
+    *out++ = a[i++];
+  while (j < nb)
+    *out++ = b[j++];
+}
+
+// Number of elements of a among the first k of the merge of a and b
+static size_t co_rank(size_t k, const double *a, size_t na, const double *b, size_t nb)
+{
+  size_t lo = (k > nb) ? k - nb : 0, hi = (k < na) ? k : na;
+  while (lo < hi)
+  {
+    size_t i = lo + (hi - lo) / 2, j = k - i;
+    if (j > 0 && a[i] <= b[j - 1])
+      lo = i + 1;
+    else
+      hi = i;
+  }
+  return lo;
+}
+
+/**
+ * bitonic_merge_sort function:
+ * this function sorts the n elements of tab in ascending order.
+ */
+void bitonic_merge_sort(size_t n, double tab[n])
+{
+  double *buffer = malloc(n * sizeof(double));
+  double *src = tab, *dst = buffer;
+  size_t block = sort_block, width = block, T = (size_t)omp_get_max_threads();
+
+  #pragma omp parallel for schedule(static)
+  for (size_t b = 0; b < n / block; b++)
+    block_sort(tab + b * block);
+  for (size_t i = n / block * block + 1; i < n; i++) // Last partial block
+  {
+    double v = tab[i];
+    size_t j = i;
+    for (; j > n / block * block && tab[j - 1] > v; j--)
+      tab[j] = tab[j - 1];
+    tab[j] = v;
+  }
+
+  for (; width < n; width *= 2)
   {
-#pragma omp for
-    for (i = 0; i < N; i++)
+    size_t pairs = (n + 2 * width - 1) / (2 * width);
+    if (pairs >= T)
+    {
+      #pragma omp parallel for schedule(static)
+      for (size_t p = 0; p < pairs; p++)
+      {
+        size_t lo = 2 * p * width, mid = min(lo + width, n), hi = min(lo + 2 * width, n);
+        merge(src + lo, mid - lo, src + mid, hi - mid, dst + lo);
+      }
+    }
+    else
     {
-      for (j = 0; j < N - i - 1; j++)
+      for (size_t p = 0; p < pairs; p++)
       {
-        if (tab[j] > tab[j + 1])
+        size_t lo = 2 * p * width, mid = min(lo + width, n), hi = min(lo + 2 * width, n);
+        double *a = src + lo, *b = src + mid;
+        size_t na = mid - lo, nb = hi - mid;
+        #pragma omp parallel for schedule(static)
+        for (size_t t = 0; t < T; t++)
         {
-#pragma omp atomic read
-          {
-            temp = tab[j + 1];
-
-            tab[j + 1] = tab[j];
-            tab[j] = temp;
-          }
+          size_t k0 = (na + nb) * t / T, k1 = (na + nb) * (t + 1) / T;
+          size_t i0 = co_rank(k0, a, na, b, nb), i1 = co_rank(k1, a, na, b, nb);
+          merge(a + i0, i1 - i0, b + (k0 - i0), (k1 - i1) - (k0 - i0), dst + lo + k0);
         }
       }
     }
+    double *swap = src;
+    src = dst;
+    dst = swap;
+  }
+
+  if (src != tab)
+    memcpy(tab, src, n * sizeof(double));
+  free(buffer);
+}
+
+static int compare_doubles(const void *x, const void *y)
+{
+  double a = *(const double *)x, b = *(const double *)y;
+  return (a > b) - (a < b);
+}
+
+/**
+ * sort_benchmark function:
+ * this function times qsort, the odd-even sort (up to ODD_EVEN_MAX) and
+ * the bitonic merge sort for 1e3, 1e4... up to max random elements and
+ * checks that they give the same result.
+ */
+void sort_benchmark(size_t max)
+{
+  double *keys = malloc(max * sizeof(double));
+  double *a = malloc(max * sizeof(double));
+  double *ref = malloc(max * sizeof(double));
+
+  srand((unsigned int)time(NULL));
+  for (size_t i = 0; i < max; i++)
+    keys[i] = (float)rand() / (float)(RAND_MAX / MAX_VAL);
+
+  printf("%d threads, %s sorting network\n", omp_get_max_threads(), sort_isa);
+  printf("%12s %12s %12s %12s %9s\n", "elements", "qsort (s)", "odd-even (s)", "bitonic (s)",
+         "speedup");
+  for (size_t n = 1000; n <= max; n *= 10)
+  {
+    double time_qsort, time_odd_even = 0., time_bitonic;
+
+    memcpy(ref, keys, n * sizeof(double));
+    time_qsort = omp_get_wtime();
+    qsort(ref, n, sizeof(double), compare_doubles);
+    time_qsort = omp_get_wtime() - time_qsort;
+
+    if (n <= ODD_EVEN_MAX)
+    {
+      memcpy(a, keys, n * sizeof(double));
+      time_odd_even = omp_get_wtime();
+      odd_even_sort(n, a);
+      time_odd_even = omp_get_wtime() - time_odd_even;
+      if (memcmp(a, ref, n * sizeof(double)) != 0)
+      {
+        printf("Bad odd-even results :-(((\n");
+        exit(1);
+      }
+    }
+
+    memcpy(a, keys, n * sizeof(double));
+    time_bitonic = omp_get_wtime();
+    bitonic_merge_sort(n, a);
+    time_bitonic = omp_get_wtime() - time_bitonic;
+    if (memcmp(a, ref, n * sizeof(double)) != 0)
+    {
+      printf("Bad bitonic results :-(((\n");
+      exit(1);
+    }
+
+    printf("%12zu %12.5lf ", n, time_qsort);
+    if (n <= ODD_EVEN_MAX)
+      printf("%12.5lf ", time_odd_even);
+    else
+      printf("%12s ", "-");
+    printf("%12.5lf %9.3lf\n", time_bitonic, time_qsort / time_bitonic);
   }
+  printf("OK sort results :-)\n");
+
+  free(keys);
+  free(a);
+  free(ref);
+}
+
+// Computation kernel (odd-even transposition sort)
+void bubble_sort_kernel(double tab[N])
+{
+  odd_even_sort(N, tab);
 }
 
 void print_sample(double tab[], size_t size, size_t sample_length)
@@ -74,16 +375,26 @@ void print_sample(double tab[], size_t size, size_t sample_length)
   printf("\n");
 }
 
-int main()
+int main(int argc, char *argv[])
 {
+  block_sort_init();
+
+  // Benchmark mode: tp2_4_bubble_sort bench [max elements]
+  if (argc > 1 && strcmp(argv[1], "bench") == 0)
+  {
+    sort_benchmark((argc > 2) ? (size_t)atof(argv[2]) : SORT_BENCH_MAX);
+    return 0;
+  }
+
   double *a = malloc(N * sizeof(double));
   double *ref = malloc(N * sizeof(double));
-  double time_reference, time_kernel, speedup, efficiency;
+  double *b = malloc(N * sizeof(double));
+  double time_reference, time_kernel, time_bitonic, speedup, efficiency;
 
   // Initialization by random values
   srand((unsigned int)time(NULL));
   for (size_t i = 0; i < N; i++)
-    ref[i] = a[i] = (float)rand() / (float)(RAND_MAX / MAX_VAL);
+    b[i] = ref[i] = a[i] = (float)rand() / (float)(RAND_MAX / MAX_VAL);
 
   time_reference = omp_get_wtime();
   bubble_sort_reference(ref);
@@ -114,7 +425,24 @@ int main()
   }
   printf("OK results :-)\n");
 
+  // Sorting networks and parallel merges
+  time_bitonic = omp_get_wtime();
+  bitonic_merge_sort(N, b);
+  time_bitonic = omp_get_wtime() - time_bitonic;
+  printf("Bitonic time - : %3.5lf s (%s, speedup %3.5lf)\n", time_bitonic, sort_isa,
+         time_reference / time_bitonic);
+  for (size_t i = 0; i < N; i++)
+  {
+    if (ref[i] != b[i])
+    {
+      printf("Bad bitonic results :-(((\n");
+      exit(1);
+    }
+  }
+  printf("OK bitonic results :-)\n");
+
   free(a);
+  free(b);
   free(ref);
   return 0;
 }